@@ -0,0 +1,125 @@
+/*
+ *  Copyright (c) 2016-2022 Jeremy HU <jeremy-at-dust3d dot org>. All rights reserved. 
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+
+// Standalone benchmark for mesh normal smoothing, build with "nmake benchmark".
+// Usage: smooth_normal_benchmark [tubeCount] [sectionCount] [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <hu/base/math.h>
+#include <hu/base/parallel_for.h>
+#include <dust3d/mesh/mesh_utils.h>
+#include <dust3d/mesh/tube_mesh_builder.h>
+
+static bool makeTubeMesh(size_t tubeCount, size_t sectionCount, 
+    std::vector<Hu::Vector3> *vertices, std::vector<std::vector<size_t>> *triangles, std::vector<Hu::Vector3> *triangleNormals)
+{
+    const size_t pointCount = 16;
+    std::vector<std::unique_ptr<std::vector<Dust3d::TubeMeshBuilder::Section>>> sectionsList(tubeCount);
+    for (size_t t = 0; t < tubeCount; ++t) {
+        sectionsList[t] = std::make_unique<std::vector<Dust3d::TubeMeshBuilder::Section>>(sectionCount);
+        for (size_t s = 0; s < sectionCount; ++s) {
+            auto &section = (*sectionsList[t])[s];
+            double angle = s * 0.05 + t;
+            section.origin = Hu::Vector3(s * 0.01, std::sin(angle) * 0.2, t * 0.5);
+            section.radius = 0.05 + 0.02 * std::sin(angle * 3.0);
+            section.normal = Hu::Vector3(1.0, 0.0, 0.0);
+            section.bitangent = Hu::Vector3(0.0, 0.0, 1.0);
+            for (size_t i = 0; i < pointCount; ++i) {
+                double pointAngle = Hu::Math::Pi * 2.0 * i / pointCount;
+                section.polygon.push_back(Hu::Vector2(std::cos(pointAngle), std::sin(pointAngle)));
+            }
+        }
+    }
+    Dust3d::TubeMeshBuilder::MeshBatch batch;
+    if (!Dust3d::TubeMeshBuilder::buildBatch(std::move(sectionsList), &batch))
+        return false;
+    *vertices = std::move(batch.vertices);
+    triangles->reserve(batch.quadIndices.size() / 2);
+    triangleNormals->reserve(batch.quadIndices.size() / 2);
+    for (size_t i = 0; i + 3 < batch.quadIndices.size(); i += 4) {
+        const std::uint32_t *quad = batch.quadIndices.data() + i;
+        for (const auto &triangle: {std::vector<size_t> {quad[0], quad[1], quad[2]}, std::vector<size_t> {quad[2], quad[3], quad[0]}}) {
+            triangleNormals->push_back(Hu::Vector3::normal((*vertices)[triangle[0]], (*vertices)[triangle[1]], (*vertices)[triangle[2]]));
+            triangles->push_back(triangle);
+        }
+    }
+    return true;
+}
+
+template <class Function>
+static double measureMilliseconds(size_t iterations, Function function)
+{
+    double best = 0.0;
+    for (size_t i = 0; i < iterations; ++i) {
+        auto begin = std::chrono::steady_clock::now();
+        function();
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        if (0 == i || elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t tubeCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+    size_t sectionCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 500;
+    size_t iterations = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 5;
+    
+    std::vector<Hu::Vector3> vertices;
+    std::vector<std::vector<size_t>> triangles;
+    std::vector<Hu::Vector3> triangleNormals;
+    if (!makeTubeMesh(tubeCount, sectionCount, &vertices, &triangles, &triangleNormals)) {
+        std::cout << "Generate tube mesh failed\n";
+        return 1;
+    }
+    std::cout << "Tubes: " << tubeCount << ", vertices: " << vertices.size() << ", triangles: " << triangles.size() << "\n";
+    
+    double thresholdAngle = Hu::Math::radiansFromDegrees(60);
+    std::vector<Hu::Vector3> expectedNormals;
+    double serialMilliseconds = measureMilliseconds(iterations, [&]() {
+        Dust3d::MeshUtils::smoothNormal(vertices, triangles, triangleNormals, thresholdAngle, expectedNormals);
+    });
+    std::cout << "smoothNormal: " << serialMilliseconds << " ms\n";
+    
+    // Thread counts past the pool size run on the pool's threads, so report what was actually used
+    std::cout << "Thread pool: " << Hu::ThreadPool::instance().threadCount() << " threads\n";
+    size_t lastThreadCount = 0;
+    for (size_t maxThreads: {1, 4, 16}) {
+        size_t threadCount = std::min(maxThreads, Hu::ThreadPool::instance().threadCount());
+        if (threadCount == lastThreadCount)
+            continue;
+        lastThreadCount = threadCount;
+        std::vector<Hu::Vector3> normals;
+        double milliseconds = measureMilliseconds(iterations, [&]() {
+            Dust3d::MeshUtils::smoothNormalParallel(vertices, triangles, triangleNormals, thresholdAngle, normals, threadCount);
+        });
+        std::cout << "smoothNormalParallel(" << threadCount << " threads): " << milliseconds << " ms, " << 
+            (serialMilliseconds / milliseconds) << "x" << (normals == expectedNormals ? "" : ", MISMATCH") << "\n";
+    }
+    
+    return 0;
+}
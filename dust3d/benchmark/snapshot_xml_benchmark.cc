@@ -0,0 +1,134 @@
+/*
+ *  Copyright (c) 2016-2022 Jeremy HU <jeremy-at-dust3d dot org>. All rights reserved. 
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+// Standalone benchmark for snapshot XML loading and saving, build with "nmake benchmark".
+// Usage: snapshot_xml_benchmark [nodeCount] [iterations]
+
+#include <chrono>
+#include <iostream>
+#include <hu/base/uuid.h>
+#include <dust3d/document/snapshot_xml.h>
+
+static void makeSnapshot(Dust3d::Snapshot *snapshot, size_t nodeCount)
+{
+    snapshot->canvas["originX"] = "0.500000";
+    snapshot->canvas["originY"] = "0.500000";
+    snapshot->canvas["originZ"] = "1.000000";
+    snapshot->canvas["rigType"] = "None";
+    snapshot->canvas["version"] = "1";
+    
+    std::string partId = Hu::Uuid::createUuid().toString();
+    std::vector<std::string> nodeIds(nodeCount);
+    for (size_t i = 0; i < nodeCount; ++i) {
+        nodeIds[i] = Hu::Uuid::createUuid().toString();
+        auto &node = snapshot->nodes[nodeIds[i]];
+        node["id"] = nodeIds[i];
+        node["partId"] = partId;
+        node["radius"] = "0.012345";
+        node["x"] = std::to_string(0.5 + i * 0.000001);
+        node["y"] = std::to_string(0.5 - i * 0.000001);
+        node["z"] = "1.000000";
+    }
+    for (size_t i = 0; i + 1 < nodeCount; ++i) {
+        std::string edgeId = Hu::Uuid::createUuid().toString();
+        auto &edge = snapshot->edges[edgeId];
+        edge["id"] = edgeId;
+        edge["from"] = nodeIds[i];
+        edge["to"] = nodeIds[i + 1];
+        edge["partId"] = partId;
+    }
+    
+    auto &part = snapshot->parts[partId];
+    part["id"] = partId;
+    part["subdived"] = "true";
+    part["visible"] = "true";
+    
+    std::string componentId = Hu::Uuid::createUuid().toString();
+    auto &component = snapshot->components[componentId];
+    component["id"] = componentId;
+    component["linkData"] = partId;
+    component["linkDataType"] = "partId";
+    snapshot->rootComponent["children"] = componentId;
+}
+
+template <class Function>
+static double measureMilliseconds(size_t iterations, Function function)
+{
+    double best = 0.0;
+    for (size_t i = 0; i < iterations; ++i) {
+        auto begin = std::chrono::steady_clock::now();
+        function();
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        if (0 == i || elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t nodeCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    size_t iterations = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5;
+    
+    Dust3d::Snapshot sourceSnapshot;
+    makeSnapshot(&sourceSnapshot, nodeCount);
+    std::string xmlString;
+    Dust3d::saveSnapshotToXmlString(sourceSnapshot, xmlString);
+    double megabytes = xmlString.size() / (1024.0 * 1024.0);
+    std::cout << "Nodes: " << nodeCount << ", edges: " << (nodeCount > 0 ? nodeCount - 1 : 0) << ", XML size: " << megabytes << " MB\n";
+    
+    double saveMilliseconds = measureMilliseconds(iterations, [&]() {
+        std::string savedXmlString;
+        Dust3d::saveSnapshotToXmlString(sourceSnapshot, savedXmlString);
+    });
+    std::cout << "saveSnapshotToXmlString: " << saveMilliseconds << " ms, " << (megabytes * 1000.0 / saveMilliseconds) << " MB/s\n";
+    
+    size_t loadedNodes = 0;
+    double loadMilliseconds = measureMilliseconds(iterations, [&]() {
+        std::string buffer = xmlString;
+        Dust3d::Snapshot snapshot;
+        Dust3d::loadSnapshotFromXmlString(&snapshot, buffer.data());
+        loadedNodes = snapshot.nodes.size();
+    });
+    std::cout << "loadSnapshotFromXmlString: " << loadMilliseconds << " ms, " << (megabytes * 1000.0 / loadMilliseconds) << " MB/s, nodes loaded: " << loadedNodes << "\n";
+    
+    for (auto flags: {Dust3d::SnapshotItem::Canvas, Dust3d::SnapshotItem::Material}) {
+        std::vector<std::string> buffers(iterations, xmlString);
+        size_t bufferIndex = 0;
+        double partialMilliseconds = measureMilliseconds(iterations, [&]() {
+            Dust3d::Snapshot snapshot;
+            Dust3d::loadSnapshotFromXmlString(&snapshot, buffers[bufferIndex++].data(), (uint32_t)flags);
+        });
+        std::cout << "loadSnapshotFromXmlString(" << (Dust3d::SnapshotItem::Canvas == flags ? "Canvas" : "Material") << "): " << 
+            (partialMilliseconds * 1000.0) << " us\n";
+    }
+    
+    const size_t uuidCount = 1000000;
+    size_t uuidLength = 0;
+    double uuidMilliseconds = measureMilliseconds(iterations, [&]() {
+        for (size_t i = 0; i < uuidCount; ++i)
+            uuidLength += Hu::Uuid::createUuid().toString().size();
+    });
+    std::cout << "Hu::Uuid::createUuid: " << (uuidMilliseconds * 1000000.0 / uuidCount) << " ns per id\n";
+    
+    return 0;
+}
@@ -290,7 +290,7 @@ void DocumentWindow::updateReferenceImageView()
     
     m_referenceImageFlags.dirty = false;
     
-    if (nullptr == document()->referenceImage())
+    if (!document()->hasReferenceImage())
         return;
 
     Hu::Widget *turnaroundWidget = getWidget("documentWindow.turnaround");
@@ -301,8 +301,11 @@ void DocumentWindow::updateReferenceImageView()
         return;
     
     m_referenceImageFlags.processing = true;
-    Hu::Image *image = new Hu::Image(*document()->referenceImage());
+    std::shared_future<std::shared_ptr<Hu::Image>> referenceImage = document()->loadReferenceImage();
     engine()->run([=]() {
+            std::shared_ptr<Hu::Image> image = referenceImage.get();
+            if (nullptr == image)
+                return (void *)nullptr;
             size_t toWidth = image->width();
             size_t toHeight = toWidth * targetHeight / targetWidth;
             if (toHeight < image->height()) {
@@ -312,10 +315,15 @@ void DocumentWindow::updateReferenceImageView()
             Hu::Image *resizedImage = new Hu::Image(toWidth, toHeight);
             resizedImage->clear(255, 255, 255, 0);
             resizedImage->copy(*image, 0, 0, (resizedImage->width() - image->width()) / 2, (resizedImage->height() - image->height()) / 2, image->width(), image->height());
-            delete image;
             return (void *)resizedImage;
         }, [=](void *result) {
             Hu::Image *resizedImage = (Hu::Image *)result;
+            if (nullptr == resizedImage) {
+                this->referenceImageFlags().processing = false;
+                if (this->referenceImageFlags().dirty)
+                    this->updateReferenceImageView();
+                return;
+            }
             this->engine()->setImageResource("documentWindow.turnaround", resizedImage->width(), resizedImage->height(), resizedImage->data());
             
             //{
@@ -21,6 +21,9 @@
  */
 
 #include <fstream>
+#include <filesystem>
+#include <thread>
+#include <hu/base/debug.h>
 #include <hu/base/image.h>
 #include <dust3d/document/document.h>
 #include <dust3d/document/ds3_file.h>
@@ -28,49 +31,196 @@
 namespace Dust3d
 {
 
+static Ds3FileWriter::Producer makeProducer(std::span<const std::uint8_t> data)
+{
+    return [=, offset = (size_t)0](std::uint8_t *buffer, size_t bufferSize) mutable {
+        size_t size = std::min(bufferSize, data.size() - offset);
+        std::memcpy(buffer, data.data() + offset, size);
+        offset += size;
+        return size;
+    };
+}
+
+static std::shared_ptr<Hu::Image> decodeImage(Ds3FileReader &ds3Reader, const std::string &name)
+{
+    std::vector<std::uint8_t> decodedData;
+    std::span<const std::uint8_t> data = ds3Reader.itemData(name);
+    if (Ds3Codec::None != ds3Reader.itemCodec(name)) {
+        ds3Reader.loadItem(name, &decodedData);
+        data = decodedData;
+    }
+    auto image = std::make_shared<Hu::Image>();
+    if (!image->load(data.data(), (int)data.size()))
+        return nullptr;
+    return image;
+}
+
 void Document::save(const std::string &path)
 {
-    Ds3FileWriter ds3Writer;
+    // The opened file can't stay mapped while being written, a pending image which is not yet decoding is reopened from the saved file afterwards. 
+    // An encoded one has to be decoded first, saveFile() writes it out again as PNG
+    if (m_referenceImageIsPending) {
+        const Ds3ReaderItem *savedReferenceImage = findSavedItem("canvas.png");
+        bool needsDecoding = nullptr == savedReferenceImage || Ds3Codec::None != savedReferenceImage->codec;
+        if (m_referenceImageLoading.valid() || needsDecoding)
+            resolveReferenceImage();
+        else
+            m_ds3Reader.reset();
+    }
+    
+    saveFile(path);
+    
+    if (m_referenceImageIsPending && nullptr == m_ds3Reader)
+        m_ds3Reader = std::make_shared<Ds3FileReader>(m_path);
+}
+
+void Document::saveFile(const std::string &path)
+{
+    // Reuse the stored PNG instead of encoding again when the image didn't change since last open or save
+    const Ds3ReaderItem *savedReferenceImage = findSavedItem("canvas.png");
+    bool reuseReferenceImage = hasReferenceImage() && 
+        !m_referenceImageIsDirty && 
+        nullptr != savedReferenceImage &&
+        Ds3Codec::None == savedReferenceImage->codec;
+    std::vector<std::uint8_t> pngBuffer;
+    if (hasReferenceImage() && !reuseReferenceImage)
+        referenceImage()->saveAsPng(&pngBuffer);
     
-    if (nullptr != m_referenceImage) {
-        std::vector<uint8_t> pngBuffer;
-        m_referenceImage->saveAsPng(&pngBuffer);
-        ds3Writer.add("canvas.png", "asset", &pngBuffer[0], pngBuffer.size());
+    // Saving onto the file we came from only appends what changed, until dead space outweighs live data
+    if (path == m_path && m_savedBinaryOffset > 0) {
+        long long liveSize = reuseReferenceImage ? savedReferenceImage->size : (long long)pngBuffer.size();
+        long long payloadSize = m_savedFileSize - m_savedBinaryOffset + (long long)pngBuffer.size();
+        if (payloadSize <= liveSize * 2) {
+            Ds3FileWriter ds3Writer;
+            ds3Writer.setHeadFormat(m_savedHeadFormat);
+            if (reuseReferenceImage)
+                ds3Writer.keep(*savedReferenceImage);
+            else if (!pngBuffer.empty())
+                ds3Writer.add("canvas.png", "asset", pngBuffer.size(), makeProducer(pngBuffer));
+            if (ds3Writer.saveIncrementally(path, m_savedBinaryOffset)) {
+                updateSavedState(Ds3FileReader(path), path);
+                return;
+            }
+        }
     }
     
-    ds3Writer.save(path);
+    bool saved = false;
+    std::string savingPath = path + ".saving";
+    {
+        std::unique_ptr<Ds3FileReader> savedReader;
+        Ds3FileWriter ds3Writer;
+        ds3Writer.setHeadFormat(m_savedHeadFormat);
+        ds3Writer.setHeaderReserve(Document::m_headerReserve);
+        if (reuseReferenceImage) {
+            savedReader = std::make_unique<Ds3FileReader>(m_path);
+            std::span<const std::uint8_t> data = savedReader->itemData("canvas.png");
+            ds3Writer.add("canvas.png", "asset", data.size(), makeProducer(data));
+        } else if (!pngBuffer.empty()) {
+            ds3Writer.add("canvas.png", "asset", std::move(pngBuffer));
+        }
+        saved = ds3Writer.save(savingPath);
+    }
+    if (!saved)
+        return;
+    std::error_code error;
+    std::filesystem::rename(savingPath, path, error);
+    if (error) {
+        huDebug << "Rename file failed, from:" << savingPath << "to:" << path << "error:" << error.message();
+        return;
+    }
+    updateSavedState(Ds3FileReader(path), path);
+}
+
+void Document::updateSavedState(const Ds3FileReader &ds3Reader, const std::string &path)
+{
+    m_path = path;
+    m_savedItems = ds3Reader.items();
+    m_savedBinaryOffset = ds3Reader.binaryOffset();
+    m_savedFileSize = (long long)ds3Reader.fileSize();
+    m_savedHeadFormat = ds3Reader.headFormat();
+    m_referenceImageIsDirty = false;
+}
+
+const Ds3ReaderItem *Document::findSavedItem(const std::string &name) const
+{
+    for (const auto &item: m_savedItems) {
+        if (item.name == name)
+            return &item;
+    }
+    return nullptr;
 }
 
 void Document::setReferenceImage(std::unique_ptr<Hu::Image> image)
 {
     m_referenceImage = std::move(image);
+    m_referenceImageIsPending = false;
+    m_referenceImageLoading = {};
+    m_ds3Reader.reset();
+    m_referenceImageIsDirty = true;
     referenceImageChanged.emit();
 }
 
 void Document::open(const std::string &path)
 {
-    std::ifstream is(path, std::ios::in | std::ios::binary);
-    std::vector<uint8_t> fileData((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
-    
-    Dust3d::Ds3FileReader ds3Reader(&fileData[0], fileData.size());
-    for (int i = 0; i < ds3Reader.items().size(); ++i) {
-        const Dust3d::Ds3ReaderItem &item = ds3Reader.items()[i];
-        if (item.type == "asset") {
-            if (item.name == "canvas.png") {
-                std::vector<std::uint8_t> data;
-                ds3Reader.loadItem(item.name, &data);
-                auto image = std::make_unique<Hu::Image>();
-                image->load(data.data(), (int)data.size());
-                setReferenceImage(std::move(image));
-            }
-        }
+    // Only the header is parsed here, assets stay in the mapped file until someone asks for them
+    m_referenceImage.reset();
+    m_referenceImageIsPending = false;
+    m_referenceImageLoading = {};
+    m_ds3Reader = std::make_shared<Ds3FileReader>(path);
+    for (size_t i = 0; i < m_ds3Reader->itemCount(); ++i) {
+        if (m_ds3Reader->itemName(i) == "canvas.png")
+            m_referenceImageIsPending = true;
     }
     
+    updateSavedState(*m_ds3Reader, path);
+    if (!m_referenceImageIsPending)
+        m_ds3Reader.reset();
+    
+    referenceImageChanged.emit();
+    
     // TODO:
 }
 
+bool Document::hasReferenceImage() const
+{
+    return nullptr != m_referenceImage || m_referenceImageIsPending;
+}
+
+std::shared_future<std::shared_ptr<Hu::Image>> Document::loadReferenceImage()
+{
+    if (!m_referenceImageIsPending) {
+        std::promise<std::shared_ptr<Hu::Image>> loaded;
+        loaded.set_value(m_referenceImage);
+        return loaded.get_future().share();
+    }
+    
+    if (!m_referenceImageLoading.valid()) {
+        std::packaged_task<std::shared_ptr<Hu::Image> ()> task([ds3Reader = m_ds3Reader]() mutable {
+            if (nullptr == ds3Reader)
+                return std::shared_ptr<Hu::Image>();
+            std::shared_ptr<Hu::Image> image = decodeImage(*ds3Reader, "canvas.png");
+            ds3Reader.reset();
+            return image;
+        });
+        m_referenceImageLoading = task.get_future().share();
+        std::thread(std::move(task)).detach();
+    }
+    return m_referenceImageLoading;
+}
+
+void Document::resolveReferenceImage()
+{
+    if (!m_referenceImageIsPending)
+        return;
+    m_referenceImage = loadReferenceImage().get();
+    m_referenceImageIsPending = false;
+    m_referenceImageLoading = {};
+    m_ds3Reader.reset();
+}
+
 Hu::Image *Document::referenceImage()
 {
+    resolveReferenceImage();
     return m_referenceImage.get();
 }
 
@@ -23,8 +23,10 @@
 #ifndef DUST3D_DOCUMENT_DOCUMENT_H_
 #define DUST3D_DOCUMENT_DOCUMENT_H_
 
+#include <future>
 #include <hu/base/image.h>
 #include <hu/base/signal.h>
+#include <dust3d/document/ds3_file.h>
 #include <dust3d/document/snapshot.h>
 
 namespace Dust3d
@@ -38,10 +40,27 @@ public:
     void open(const std::string &path);
     void save(const std::string &path);
     void setReferenceImage(std::unique_ptr<Hu::Image> image);
+    bool hasReferenceImage() const;
+    std::shared_future<std::shared_ptr<Hu::Image>> loadReferenceImage();
     Hu::Image *referenceImage();
+    static const size_t m_headerReserve = 4096;
     
 private:
-    std::unique_ptr<Hu::Image> m_referenceImage;
+    std::shared_ptr<Hu::Image> m_referenceImage;
+    bool m_referenceImageIsDirty = false;
+    bool m_referenceImageIsPending = false;
+    std::shared_future<std::shared_ptr<Hu::Image>> m_referenceImageLoading;
+    std::shared_ptr<Ds3FileReader> m_ds3Reader;
+    std::string m_path;
+    std::vector<Ds3ReaderItem> m_savedItems;
+    long long m_savedBinaryOffset = 0;
+    long long m_savedFileSize = 0;
+    Ds3HeadFormat m_savedHeadFormat = Ds3HeadFormat::Xml;
+    
+    void saveFile(const std::string &path);
+    void resolveReferenceImage();
+    void updateSavedState(const Ds3FileReader &ds3Reader, const std::string &path);
+    const Ds3ReaderItem *findSavedItem(const std::string &name) const;
 };
     
 }
@@ -20,11 +20,14 @@
  *  SOFTWARE.
  */
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <rapidxml.hpp>
 #include <hu/base/debug.h>
 #include <hu/base/string.h>
+#include <hu/base/deflate.h>
+#include <hu/base/parallel_for.h>
 #include <dust3d/document/ds3_file.h>
 
 namespace Dust3d
@@ -33,6 +36,50 @@ namespace Dust3d
 std::string Ds3FileReader::m_applicationName = std::string("DUST3D");
 std::string Ds3FileReader::m_fileFormatVersion = std::string("1.0");
 std::string Ds3FileReader::m_headFormat = std::string("xml");
+std::string Ds3FileReader::m_binaryFileFormatVersion = std::string("1.1");
+std::string Ds3FileReader::m_binaryHeadFormat = std::string("bin");
+const char Ds3FileReader::m_indexMagic[4] = {'D', 'S', '3', 'I'};
+
+static const char *codecToString(Ds3Codec codec)
+{
+    switch (codec) {
+        case Ds3Codec::Deflate:
+            return "deflate";
+        default:
+            return "";
+    }
+}
+
+static Ds3Codec codecFromString(const std::string &string)
+{
+    if ("deflate" == string)
+        return Ds3Codec::Deflate;
+    return Ds3Codec::None;
+}
+
+static bool decodeItem(Ds3Codec codec, std::span<const std::uint8_t> data, size_t rawSize, std::vector<std::uint8_t> *byteArray)
+{
+    switch (codec) {
+        case Ds3Codec::None:
+            byteArray->assign(data.begin(), data.end());
+            return true;
+        case Ds3Codec::Deflate:
+            return Hu::Deflate::decompress(data.data(), data.size(), rawSize, byteArray);
+    }
+    byteArray->clear();
+    return false;
+}
+
+// Raw sizes come straight from the head, encoded items claiming more than their stored bytes can hold get -1 
+// so loading them fails instead of allocating whatever the file asks for
+static long long checkedRawSize(Ds3Codec codec, std::uint64_t size, std::uint64_t rawSize)
+{
+    if (Ds3Codec::Deflate == codec && !Hu::Deflate::rawSizeIsPlausible((size_t)size, (size_t)rawSize)) {
+        huDebug << "Implausible raw size:" << rawSize << "stored size:" << size;
+        return -1;
+    }
+    return (long long)rawSize;
+}
 
 std::string Ds3FileReader::readFirstLine(const std::uint8_t *data, size_t size)
 {
@@ -46,9 +93,28 @@ std::string Ds3FileReader::readFirstLine(const std::uint8_t *data, size_t size)
     return std::string();
 }
 
-Ds3FileReader::Ds3FileReader(const std::uint8_t *fileData, size_t fileSize)
+Ds3FileReader::Ds3FileReader(const std::uint8_t *fileData, size_t fileSize):
+    m_fileContent(fileData, fileData + fileSize)
+{
+    m_fileData = m_fileContent.data();
+    m_fileSize = m_fileContent.size();
+    parseHeader();
+}
+
+Ds3FileReader::Ds3FileReader(const std::string &path)
+{
+    if (!m_mappedFile.open(path))
+        return;
+    m_fileData = m_mappedFile.data();
+    m_fileSize = m_mappedFile.size();
+    parseHeader();
+}
+
+void Ds3FileReader::parseHeader()
 {
     m_headerIsGood = false;
+    const std::uint8_t *fileData = m_fileData;
+    size_t fileSize = m_fileSize;
     std::string firstLine = readFirstLine(fileData, fileSize);
     std::vector<std::string> tokens = Hu::String::split(firstLine, ' ');
     if (tokens.size() < 4) {
@@ -59,22 +125,42 @@ Ds3FileReader::Ds3FileReader(const std::uint8_t *fileData, size_t fileSize)
         huDebug << "Unrecognized application name:" << tokens[0];
         return;
     }
-    if (tokens[1] != Ds3FileReader::m_fileFormatVersion) {
+    // Version 1.1 adds the binary head and encoded items, its head may be either format
+    bool isBinaryHead = false;
+    if (tokens[1] == Ds3FileReader::m_binaryFileFormatVersion) {
+        if (tokens[2] == Ds3FileReader::m_binaryHeadFormat) {
+            isBinaryHead = true;
+        } else if (tokens[2] != Ds3FileReader::m_headFormat) {
+            huDebug << "Unrecognized file head format:" << tokens[2];
+            return;
+        }
+    } else if (tokens[1] == Ds3FileReader::m_fileFormatVersion) {
+        if (tokens[2] != Ds3FileReader::m_headFormat) {
+            huDebug << "Unrecognized file head format:" << tokens[2];
+            return;
+        }
+    } else {
         huDebug << "Unrecognized file format version:" << tokens[1];
         return;
     }
-    if (tokens[2] != Ds3FileReader::m_headFormat) {
-        huDebug << "Unrecognized file head format:" << tokens[2];
-        return;
-    }
     m_binaryOffset = std::stoull(tokens[3]);
-    if (m_binaryOffset > (long long)fileSize) {
+    if (m_binaryOffset > (long long)fileSize || m_binaryOffset < (long long)firstLine.size() + 1) {
         m_binaryOffset = 0;
         return;
     }
-    std::vector<char> header(m_binaryOffset - firstLine.size() + 1);
-    std::memcpy(header.data(), fileData + firstLine.size(), header.size() - 1);
-    header[header.size() - 1] = '\0';
+    if (isBinaryHead) {
+        parseBinaryHeader(fileData + firstLine.size() + 1, m_binaryOffset - firstLine.size() - 1);
+        return;
+    }
+    parseXmlHeader(fileData + firstLine.size(), m_binaryOffset - firstLine.size());
+}
+
+void Ds3FileReader::parseXmlHeader(const std::uint8_t *data, size_t size)
+{
+    size_t fileSize = m_fileSize;
+    std::vector<char> header(size + 1);
+    std::memcpy(header.data(), data, size);
+    header[size] = '\0';
     
     try {
         rapidxml::xml_document<> xml;
@@ -83,8 +169,6 @@ Ds3FileReader::Ds3FileReader(const std::uint8_t *fileData, size_t fileSize)
         if (nullptr == rootNode)
             return;
         m_headerIsGood = true;
-        m_fileContent = std::vector<std::uint8_t>(fileSize);
-        std::memcpy(m_fileContent.data(), fileData, fileSize);
         for (rapidxml::xml_node<> *node = rootNode->first_node(); nullptr != node; node = node->next_sibling()) {
             Ds3ReaderItem readerItem;
             rapidxml::xml_attribute<> *attribute;
@@ -95,10 +179,15 @@ Ds3FileReader::Ds3FileReader(const std::uint8_t *fileData, size_t fileSize)
                 readerItem.offset = std::stoull(attribute->value());
             if (nullptr != (attribute=node->first_attribute("size")))
                 readerItem.size = std::stoull(attribute->value());
+            if (nullptr != (attribute=node->first_attribute("codec")))
+                readerItem.codec = codecFromString(attribute->value());
+            if (nullptr != (attribute=node->first_attribute("rawSize")))
+                readerItem.rawSize = std::stoull(attribute->value());
             if (readerItem.offset > (long long)fileSize)
                 continue;
             if (readerItem.offset + readerItem.size > (long long)fileSize)
                 continue;
+            readerItem.rawSize = checkedRawSize(readerItem.codec, (std::uint64_t)readerItem.size, (std::uint64_t)readerItem.rawSize);
             m_items.push_back(readerItem);
             m_itemsMap[readerItem.name] = readerItem;
         }
@@ -113,27 +202,205 @@ Ds3FileReader::Ds3FileReader(const std::uint8_t *fileData, size_t fileSize)
     }
 }
 
-void Ds3FileReader::loadItem(const std::string &name, std::vector<std::uint8_t> *byteArray)
+void Ds3FileReader::parseBinaryHeader(const std::uint8_t *data, size_t size)
 {
-    byteArray->clear();
-    if (!m_headerIsGood)
+    Ds3IndexHeader indexHeader;
+    if (size < sizeof(indexHeader)) {
+        huDebug << "Binary header too small:" << size;
+        return;
+    }
+    std::memcpy(&indexHeader, data, sizeof(indexHeader));
+    if (0 != std::memcmp(indexHeader.magic, Ds3FileReader::m_indexMagic, sizeof(indexHeader.magic))) {
+        huDebug << "Unrecognized binary header magic";
         return;
-    if (m_itemsMap.find(name) == m_itemsMap.end()) {
+    }
+    size_t entriesSize = (size_t)indexHeader.itemCount * sizeof(Ds3IndexEntry);
+    if (sizeof(indexHeader) + entriesSize + indexHeader.nameTableSize > size) {
+        huDebug << "Binary header truncated, items:" << indexHeader.itemCount;
         return;
     }
-    Ds3ReaderItem readerItem = m_itemsMap[name];
-    byteArray->resize(readerItem.size, 0);
-    std::memcpy((char *)byteArray->data(), 
-        m_fileContent.data() + m_binaryOffset + readerItem.offset, 
-        byteArray->size());
+    const std::uint8_t *entries = data + sizeof(indexHeader);
+    const char *nameTable = (const char *)(entries + entriesSize);
+    // Entries are checked once here, so a good head means every accessor sees the same complete set of items
+    std::uint64_t binarySize = (std::uint64_t)m_fileSize - (std::uint64_t)m_binaryOffset;
+    for (size_t i = 0; i < indexHeader.itemCount; ++i) {
+        Ds3IndexEntry entry;
+        std::memcpy(&entry, entries + i * sizeof(Ds3IndexEntry), sizeof(entry));
+        if (entry.offset > binarySize || entry.size > binarySize - entry.offset) {
+            huDebug << "Binary header item out of file, index:" << i;
+            return;
+        }
+        if ((std::uint64_t)entry.nameOffset + entry.nameSize > indexHeader.nameTableSize || 
+                (std::uint64_t)entry.typeOffset + entry.typeSize > indexHeader.nameTableSize) {
+            huDebug << "Binary header item name out of name table, index:" << i;
+            return;
+        }
+    }
+    m_indexEntries = entries;
+    m_indexItemCount = indexHeader.itemCount;
+    m_indexNameTable = nameTable;
+    m_indexNameTableSize = indexHeader.nameTableSize;
+    m_headerIsGood = true;
+}
+
+Ds3IndexEntry Ds3FileReader::indexEntry(size_t index) const
+{
+    Ds3IndexEntry entry;
+    std::memcpy(&entry, m_indexEntries + index * sizeof(Ds3IndexEntry), sizeof(entry));
+    return entry;
+}
+
+std::string_view Ds3FileReader::indexString(std::uint32_t offset, std::uint32_t size) const
+{
+    if ((size_t)offset + size > m_indexNameTableSize)
+        return std::string_view();
+    return std::string_view(m_indexNameTable + offset, size);
+}
+
+bool Ds3FileReader::findIndexEntry(const std::string &name, Ds3IndexEntry *entry) const
+{
+    size_t low = 0;
+    size_t high = m_indexItemCount;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        Ds3IndexEntry middleEntry = indexEntry(middle);
+        int compared = indexString(middleEntry.nameOffset, middleEntry.nameSize).compare(name);
+        if (0 == compared) {
+            *entry = middleEntry;
+            return true;
+        }
+        if (compared < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return false;
+}
+
+bool Ds3FileReader::findItem(const std::string &name, Ds3ReaderItem *item) const
+{
+    if (!m_headerIsGood)
+        return false;
+    if (nullptr != m_indexEntries) {
+        Ds3IndexEntry entry;
+        if (!findIndexEntry(name, &entry))
+            return false;
+        item->offset = (long long)entry.offset;
+        item->size = (long long)entry.size;
+        item->codec = (Ds3Codec)entry.codec;
+        item->rawSize = checkedRawSize(item->codec, entry.size, entry.rawSize);
+        return true;
+    }
+    auto findItem = m_itemsMap.find(name);
+    if (findItem == m_itemsMap.end())
+        return false;
+    *item = findItem->second;
+    return true;
+}
+
+std::span<const std::uint8_t> Ds3FileReader::storedData(const Ds3ReaderItem &item) const
+{
+    if (item.offset < 0 || item.size < 0 || m_binaryOffset + item.offset + item.size > (long long)m_fileSize)
+        return std::span<const std::uint8_t>();
+    return std::span<const std::uint8_t>(m_fileData + m_binaryOffset + item.offset, (size_t)item.size);
+}
+
+// The stored bytes of the item, still encoded when itemCodec() is not Ds3Codec::None
+std::span<const std::uint8_t> Ds3FileReader::itemData(const std::string &name) const
+{
+    Ds3ReaderItem item;
+    if (!findItem(name, &item))
+        return std::span<const std::uint8_t>();
+    return storedData(item);
+}
+
+Ds3Codec Ds3FileReader::itemCodec(const std::string &name) const
+{
+    Ds3ReaderItem item;
+    if (!findItem(name, &item))
+        return Ds3Codec::None;
+    return item.codec;
+}
+
+void Ds3FileReader::loadItem(const std::string &name, std::vector<std::uint8_t> *byteArray)
+{
+    byteArray->clear();
+    Ds3ReaderItem item;
+    if (!findItem(name, &item))
+        return;
+    if (item.rawSize < 0 || !decodeItem(item.codec, storedData(item), (size_t)item.rawSize, byteArray))
+        huDebug << "Decode item failed, name:" << name;
+}
+
+void Ds3FileReader::loadItems(const std::vector<std::string> &names, std::vector<std::vector<std::uint8_t>> *byteArrays)
+{
+    byteArrays->resize(names.size());
+    Hu::parallelFor(names.size(), [&](size_t i) {
+        loadItem(names[i], &(*byteArrays)[i]);
+    });
 }
 
 const std::vector<Ds3ReaderItem> &Ds3FileReader::items() const
 {
+    if (nullptr != m_indexEntries && m_items.empty()) {
+        m_items.reserve(m_indexItemCount);
+        for (size_t i = 0; i < m_indexItemCount; ++i) {
+            Ds3IndexEntry entry = indexEntry(i);
+            Ds3ReaderItem readerItem;
+            readerItem.type = indexString(entry.typeOffset, entry.typeSize);
+            readerItem.name = indexString(entry.nameOffset, entry.nameSize);
+            readerItem.offset = (long long)entry.offset;
+            readerItem.size = (long long)entry.size;
+            readerItem.codec = (Ds3Codec)entry.codec;
+            readerItem.rawSize = checkedRawSize(readerItem.codec, entry.size, entry.rawSize);
+            m_items.push_back(readerItem);
+        }
+    }
     return m_items;
 }
 
-bool Ds3FileWriter::add(const std::string &name, const std::string &type, const void *buffer, size_t bufferSize)
+long long Ds3FileReader::binaryOffset() const
+{
+    return m_binaryOffset;
+}
+
+size_t Ds3FileReader::fileSize() const
+{
+    return m_fileSize;
+}
+
+Ds3HeadFormat Ds3FileReader::headFormat() const
+{
+    return nullptr != m_indexEntries ? Ds3HeadFormat::Binary : Ds3HeadFormat::Xml;
+}
+
+size_t Ds3FileReader::itemCount() const
+{
+    if (nullptr != m_indexEntries)
+        return m_indexItemCount;
+    return m_items.size();
+}
+
+std::string_view Ds3FileReader::itemName(size_t index) const
+{
+    if (nullptr != m_indexEntries) {
+        if (index >= m_indexItemCount)
+            return std::string_view();
+        Ds3IndexEntry entry = indexEntry(index);
+        return indexString(entry.nameOffset, entry.nameSize);
+    }
+    if (index >= m_items.size())
+        return std::string_view();
+    return m_items[index].name;
+}
+
+bool Ds3FileWriter::add(const std::string &name, const std::string &type, const void *buffer, size_t bufferSize, Ds3Codec codec)
+{
+    const std::uint8_t *bytes = (const std::uint8_t *)buffer;
+    return add(name, type, std::vector<std::uint8_t>(bytes, bytes + bufferSize), codec);
+}
+
+bool Ds3FileWriter::add(const std::string &name, const std::string &type, std::vector<std::uint8_t> &&byteArray, Ds3Codec codec)
 {
     if (m_itemsMap.find(name) != m_itemsMap.end()) {
         return false;
@@ -141,11 +408,50 @@ bool Ds3FileWriter::add(const std::string &name, const std::string &type, const
     Ds3WriterItem writerItem;
     writerItem.type = type;
     writerItem.name = name;
-    writerItem.byteArray.resize(bufferSize);
-    for (size_t i = 0; i < bufferSize; ++i)
-        writerItem.byteArray[i] = ((const std::uint8_t *)buffer)[i];
-    m_itemsMap[name] = writerItem;
-    m_items.push_back(writerItem);
+    writerItem.size = byteArray.size();
+    writerItem.byteArray = std::move(byteArray);
+    writerItem.codec = codec;
+    m_itemsMap.insert({name, m_items.size()});
+    m_items.push_back(std::move(writerItem));
+    return true;
+}
+
+bool Ds3FileWriter::add(const std::string &name, const std::string &type, size_t size, Producer producer)
+{
+    if (m_itemsMap.find(name) != m_itemsMap.end()) {
+        return false;
+    }
+    if (nullptr == producer) {
+        return false;
+    }
+    Ds3WriterItem writerItem;
+    writerItem.type = type;
+    writerItem.name = name;
+    writerItem.size = size;
+    writerItem.producer = std::move(producer);
+    m_itemsMap.insert({name, m_items.size()});
+    m_items.push_back(std::move(writerItem));
+    return true;
+}
+
+bool Ds3FileWriter::keep(const Ds3ReaderItem &item)
+{
+    if (m_itemsMap.find(item.name) != m_itemsMap.end()) {
+        return false;
+    }
+    if (item.rawSize < 0)
+        return false;
+    Ds3WriterItem writerItem;
+    writerItem.type = item.type;
+    writerItem.name = item.name;
+    writerItem.size = (size_t)item.size;
+    writerItem.codec = item.codec;
+    writerItem.rawSize = (size_t)item.rawSize;
+    writerItem.encoded = true;
+    writerItem.kept = true;
+    writerItem.keptOffset = (std::uint64_t)item.offset;
+    m_itemsMap.insert({item.name, m_items.size()});
+    m_items.push_back(std::move(writerItem));
     return true;
 }
 
@@ -164,45 +470,200 @@ static std::string doubleQuoteEscapedForXml(const std::string &string)
     return escapedString;
 }
 
-bool Ds3FileWriter::save(const std::string &filename)
+void Ds3FileWriter::encodeItems()
 {
-    std::ofstream file(filename, std::ios::out | std::ios::trunc | std::ios::binary);
-    if (!file.is_open()) {
-        huDebug << "Open file failed, path:" << filename;
-        return false;
+    std::vector<Ds3WriterItem *> pendingItems;
+    for (auto &writerItem: m_items) {
+        if (writerItem.encoded || writerItem.kept || Ds3Codec::None == writerItem.codec || nullptr != writerItem.producer)
+            continue;
+        pendingItems.push_back(&writerItem);
     }
-    
+    Hu::parallelFor(pendingItems.size(), [&](size_t i) {
+        Ds3WriterItem *writerItem = pendingItems[i];
+        std::vector<std::uint8_t> encodedByteArray;
+        bool encoded = false;
+        switch (writerItem->codec) {
+            case Ds3Codec::Deflate:
+                encoded = Hu::Deflate::compress(writerItem->byteArray.data(), writerItem->byteArray.size(), &encodedByteArray);
+                break;
+            default:
+                break;
+        }
+        writerItem->encoded = true;
+        if (!encoded || encodedByteArray.size() >= writerItem->byteArray.size()) {
+            writerItem->codec = Ds3Codec::None;
+            return;
+        }
+        writerItem->rawSize = writerItem->byteArray.size();
+        writerItem->byteArray = std::move(encodedByteArray);
+        writerItem->size = writerItem->byteArray.size();
+    });
+}
+
+void Ds3FileWriter::setHeadFormat(Ds3HeadFormat headFormat)
+{
+    m_headFormat = headFormat;
+}
+
+void Ds3FileWriter::setHeaderReserve(size_t headerReserve)
+{
+    m_headerReserve = headerReserve;
+}
+
+std::string Ds3FileWriter::makeXmlHeader(const std::vector<std::uint64_t> &offsets) const
+{
     std::ostringstream headerXmlStream;
     headerXmlStream << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << std::endl;
     headerXmlStream << "<ds3>" << std::endl;
     {
-        long long offset = 0;
         for (int i = 0; i < m_items.size(); i++) {
-            Ds3WriterItem *writerItem = &m_items[i];
+            const Ds3WriterItem *writerItem = &m_items[i];
             headerXmlStream << "    <" << writerItem->type;
                 headerXmlStream << " name=\"" << doubleQuoteEscapedForXml(writerItem->name) << "\"";
-                headerXmlStream << " offset=\"" << std::to_string(offset) << "\"";
-                headerXmlStream << " size=\"" << std::to_string(writerItem->byteArray.size()) << "\"";
-                offset += writerItem->byteArray.size();
+                headerXmlStream << " offset=\"" << std::to_string(offsets[i]) << "\"";
+                headerXmlStream << " size=\"" << std::to_string(writerItem->size) << "\"";
+                if (Ds3Codec::None != writerItem->codec) {
+                    headerXmlStream << " codec=\"" << codecToString(writerItem->codec) << "\"";
+                    headerXmlStream << " rawSize=\"" << std::to_string(writerItem->rawSize) << "\"";
+                }
             headerXmlStream << "/>" << std::endl;
         }
     }
     headerXmlStream << "</ds3>" << std::endl;
-    std::string headerXml = headerXmlStream.str();
+    return headerXmlStream.str();
+}
+
+std::string Ds3FileWriter::makeBinaryHeader(const std::vector<std::uint64_t> &offsets) const
+{
+    std::vector<size_t> sortedIndices(m_items.size());
+    for (size_t i = 0; i < m_items.size(); ++i)
+        sortedIndices[i] = i;
+    std::sort(sortedIndices.begin(), sortedIndices.end(), [&](size_t first, size_t second) {
+        return m_items[first].name < m_items[second].name;
+    });
+    
+    std::string nameTable;
+    std::vector<Ds3IndexEntry> entries(m_items.size());
+    for (size_t i = 0; i < sortedIndices.size(); ++i) {
+        const Ds3WriterItem &writerItem = m_items[sortedIndices[i]];
+        Ds3IndexEntry &entry = entries[i];
+        entry.offset = offsets[sortedIndices[i]];
+        entry.size = writerItem.size;
+        entry.nameOffset = (std::uint32_t)nameTable.size();
+        entry.nameSize = (std::uint32_t)writerItem.name.size();
+        nameTable += writerItem.name;
+        entry.typeOffset = (std::uint32_t)nameTable.size();
+        entry.typeSize = (std::uint32_t)writerItem.type.size();
+        nameTable += writerItem.type;
+        entry.rawSize = writerItem.rawSize;
+        entry.codec = (std::uint32_t)writerItem.codec;
+        entry.reserved = 0;
+    }
+    
+    Ds3IndexHeader indexHeader;
+    std::memcpy(indexHeader.magic, Ds3FileReader::m_indexMagic, sizeof(indexHeader.magic));
+    indexHeader.itemCount = (std::uint32_t)entries.size();
+    indexHeader.nameTableSize = (std::uint32_t)nameTable.size();
+    indexHeader.reserved = 0;
+    
+    std::string header;
+    header.reserve(sizeof(indexHeader) + entries.size() * sizeof(Ds3IndexEntry) + nameTable.size());
+    header.append((const char *)&indexHeader, sizeof(indexHeader));
+    header.append((const char *)entries.data(), entries.size() * sizeof(Ds3IndexEntry));
+    header += nameTable;
+    return header;
+}
+
+// Files with encoded items are stamped 1.1 even with an xml head, so 1.0 readers reject them 
+// instead of returning the encoded bytes as item data
+std::string Ds3FileWriter::makeFileHead(const std::vector<std::uint64_t> &offsets, size_t reserveSize) const
+{
+    bool isBinaryHead = Ds3HeadFormat::Binary == m_headFormat;
+    bool hasEncodedItems = std::any_of(m_items.begin(), m_items.end(), [](const Ds3WriterItem &writerItem) {
+        return Ds3Codec::None != writerItem.codec;
+    });
+    std::string header = isBinaryHead ? makeBinaryHeader(offsets) : makeXmlHeader(offsets);
     char firstLine[1024];
     int firstLineSizeExcludeSizeSelf = sprintf(firstLine, "%s %s %s ",
         Ds3FileReader::m_applicationName.c_str(),
-        Ds3FileReader::m_fileFormatVersion.c_str(),
-        Ds3FileReader::m_headFormat.c_str());
-    unsigned int headerSize = (unsigned int)(firstLineSizeExcludeSizeSelf + 12 + headerXml.size());
+        (isBinaryHead || hasEncodedItems) ? Ds3FileReader::m_binaryFileFormatVersion.c_str() : Ds3FileReader::m_fileFormatVersion.c_str(),
+        isBinaryHead ? Ds3FileReader::m_binaryHeadFormat.c_str() : Ds3FileReader::m_headFormat.c_str());
+    size_t headerSize = firstLineSizeExcludeSizeSelf + 12 + header.size();
+    
+    // Pad the header, so later incremental saves can rewrite it in place
+    if (headerSize < reserveSize) {
+        header.append(reserveSize - headerSize, isBinaryHead ? '\0' : ' ');
+        headerSize = reserveSize;
+    }
+    
     char headerSizeString[100] = {0};
-    sprintf(headerSizeString, "%010u\r\n", headerSize);
-    file.write(firstLine, firstLineSizeExcludeSizeSelf);
-    file.write(headerSizeString, strlen(headerSizeString));
-    file << headerXml;
+    sprintf(headerSizeString, "%010u\r\n", (unsigned int)headerSize);
+    std::string head;
+    head.reserve(headerSize);
+    head.append(firstLine, firstLineSizeExcludeSizeSelf);
+    head.append(headerSizeString);
+    head += header;
+    return head;
+}
+
+bool Ds3FileWriter::writePayload(std::ostream &file, Ds3WriterItem &writerItem, std::vector<std::uint8_t> &chunk)
+{
+    if (nullptr == writerItem.producer) {
+        file.write((char *)writerItem.byteArray.data(), writerItem.byteArray.size());
+        return true;
+    }
+    if (chunk.empty())
+        chunk.resize(Ds3FileWriter::m_chunkSize);
+    size_t remainingSize = writerItem.size;
+    while (remainingSize > 0) {
+        size_t producedSize = writerItem.producer(chunk.data(), std::min(chunk.size(), remainingSize));
+        if (0 == producedSize || producedSize > remainingSize) {
+            huDebug << "Item produced unexpected size, name:" << writerItem.name << "declared:" << writerItem.size;
+            return false;
+        }
+        file.write((char *)chunk.data(), producedSize);
+        remainingSize -= producedSize;
+    }
+    return true;
+}
+
+bool Ds3FileWriter::save(const std::string &filename)
+{
+    for (const auto &writerItem: m_items) {
+        if (writerItem.kept) {
+            huDebug << "Kept item requires incremental save, name:" << writerItem.name;
+            return false;
+        }
+    }
+    
+    std::ofstream file(filename, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!file.is_open()) {
+        huDebug << "Open file failed, path:" << filename;
+        return false;
+    }
+    
+    encodeItems();
+    
+    std::vector<std::uint64_t> offsets(m_items.size());
+    {
+        std::uint64_t offset = 0;
+        for (size_t i = 0; i < m_items.size(); ++i) {
+            offsets[i] = offset;
+            offset += m_items[i].size;
+        }
+    }
+    std::string head = makeFileHead(offsets, 0);
+    if (m_headerReserve > 0)
+        head = makeFileHead(offsets, head.size() + m_headerReserve);
+    file.write(head.data(), head.size());
+    std::vector<std::uint8_t> chunk;
     for (int i = 0; i < m_items.size(); i++) {
-        Ds3WriterItem *writerItem = &m_items[i];
-        file.write((char *)writerItem->byteArray.data(), writerItem->byteArray.size());
+        if (!writePayload(file, m_items[i], chunk))
+            return false;
+    }
+    if (!file.good()) {
+        huDebug << "Write file failed, path:" << filename;
+        return false;
     }
     
     huDebug << "File saved:" << filename;
@@ -210,4 +671,64 @@ bool Ds3FileWriter::save(const std::string &filename)
     return true;
 }
 
+bool Ds3FileWriter::saveIncrementally(const std::string &filename, long long binaryOffset)
+{
+    std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+        huDebug << "Open file failed, path:" << filename;
+        return false;
+    }
+    file.seekp(0, std::ios::end);
+    long long fileSize = (long long)file.tellp();
+    if (binaryOffset <= 0 || fileSize < binaryOffset) {
+        huDebug << "Unexpected binary offset:" << binaryOffset << "file size:" << fileSize;
+        return false;
+    }
+    
+    encodeItems();
+    
+    // Kept items stay where they are, everything else goes after the current end of file
+    std::vector<std::uint64_t> offsets(m_items.size());
+    std::uint64_t appendOffset = (std::uint64_t)(fileSize - binaryOffset);
+    for (size_t i = 0; i < m_items.size(); ++i) {
+        const Ds3WriterItem &writerItem = m_items[i];
+        if (writerItem.kept) {
+            if (writerItem.keptOffset + writerItem.size > (std::uint64_t)(fileSize - binaryOffset)) {
+                huDebug << "Kept item out of range, name:" << writerItem.name;
+                return false;
+            }
+            offsets[i] = writerItem.keptOffset;
+            continue;
+        }
+        offsets[i] = appendOffset;
+        appendOffset += writerItem.size;
+    }
+    std::string head = makeFileHead(offsets, (size_t)binaryOffset);
+    if (head.size() != (size_t)binaryOffset) {
+        huDebug << "Header outgrew reserved space, need:" << head.size() << "have:" << binaryOffset;
+        return false;
+    }
+    
+    // Append payloads before touching the header, so an interrupted save leaves the old header valid
+    std::vector<std::uint8_t> chunk;
+    for (auto &writerItem: m_items) {
+        if (writerItem.kept)
+            continue;
+        if (!writePayload(file, writerItem, chunk))
+            return false;
+    }
+    file.flush();
+    file.seekp(0, std::ios::beg);
+    file.write(head.data(), head.size());
+    file.flush();
+    if (!file.good()) {
+        huDebug << "Write file failed, path:" << filename;
+        return false;
+    }
+    
+    huDebug << "File saved incrementally:" << filename;
+    
+    return true;
+}
+
 }
@@ -26,33 +26,100 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <span>
+#include <string_view>
+#include <functional>
+#include <hu/base/mapped_file.h>
 
 namespace Dust3d
 {
 
+enum class Ds3HeadFormat
+{
+    Xml,
+    Binary
+};
+
+enum class Ds3Codec
+{
+    None = 0,
+    Deflate = 1
+};
+
+// Fixed-size entry of the binary table of contents, entries are sorted by name
+struct Ds3IndexEntry
+{
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::uint32_t nameOffset;
+    std::uint32_t nameSize;
+    std::uint32_t typeOffset;
+    std::uint32_t typeSize;
+    std::uint64_t rawSize;
+    std::uint32_t codec;
+    std::uint32_t reserved;
+};
+
+struct Ds3IndexHeader
+{
+    char magic[4];
+    std::uint32_t itemCount;
+    std::uint32_t nameTableSize;
+    std::uint32_t reserved;
+};
+
 class Ds3ReaderItem
 {
 public:
     std::string type;
     std::string name;
-    long long offset;
-    long long size;
+    long long offset = 0;
+    long long size = 0;
+    Ds3Codec codec = Ds3Codec::None;
+    long long rawSize = 0;
 };
 
 class Ds3FileReader
 {
 public:
     Ds3FileReader(const std::uint8_t *fileData, size_t fileSize);
+    Ds3FileReader(const std::string &path);
     void loadItem(const std::string &name, std::vector<std::uint8_t> *byteArray);
+    void loadItems(const std::vector<std::string> &names, std::vector<std::vector<std::uint8_t>> *byteArrays);
+    std::span<const std::uint8_t> itemData(const std::string &name) const;
+    Ds3Codec itemCodec(const std::string &name) const;
     const std::vector<Ds3ReaderItem> &items() const;
+    size_t itemCount() const;
+    std::string_view itemName(size_t index) const;
+    long long binaryOffset() const;
+    size_t fileSize() const;
+    Ds3HeadFormat headFormat() const;
     static std::string m_applicationName;
     static std::string m_fileFormatVersion;
     static std::string m_headFormat;
+    static std::string m_binaryFileFormatVersion;
+    static std::string m_binaryHeadFormat;
+    static const char m_indexMagic[4];
 private:
     std::map<std::string, Ds3ReaderItem> m_itemsMap;
-    std::vector<Ds3ReaderItem> m_items;
+    mutable std::vector<Ds3ReaderItem> m_items;
     std::vector<std::uint8_t> m_fileContent;
+    Hu::MappedFile m_mappedFile;
+    const std::uint8_t *m_fileData = nullptr;
+    size_t m_fileSize = 0;
+    const std::uint8_t *m_indexEntries = nullptr;
+    const char *m_indexNameTable = nullptr;
+    size_t m_indexItemCount = 0;
+    size_t m_indexNameTableSize = 0;
 private:
+    void parseHeader();
+    void parseXmlHeader(const std::uint8_t *data, size_t size);
+    void parseBinaryHeader(const std::uint8_t *data, size_t size);
+    Ds3IndexEntry indexEntry(size_t index) const;
+    std::string_view indexString(std::uint32_t offset, std::uint32_t size) const;
+    bool findIndexEntry(const std::string &name, Ds3IndexEntry *entry) const;
+    bool findItem(const std::string &name, Ds3ReaderItem *item) const;
+    std::span<const std::uint8_t> storedData(const Ds3ReaderItem &item) const;
     static std::string readFirstLine(const std::uint8_t *data, size_t size);
     bool m_headerIsGood = false;
     long long m_binaryOffset = 0;
@@ -64,17 +131,40 @@ public:
     std::string type;
     std::string name;
     std::vector<std::uint8_t> byteArray;
+    size_t size = 0;
+    std::function<size_t (std::uint8_t *buffer, size_t bufferSize)> producer;
+    Ds3Codec codec = Ds3Codec::None;
+    size_t rawSize = 0;
+    bool encoded = false;
+    bool kept = false;
+    std::uint64_t keptOffset = 0;
 };
 
 class Ds3FileWriter
 {
 public:
-    bool add(const std::string &name, const std::string &type, const void *buffer, size_t bufferSize);
+    typedef std::function<size_t (std::uint8_t *buffer, size_t bufferSize)> Producer;
+    
+    bool add(const std::string &name, const std::string &type, const void *buffer, size_t bufferSize, Ds3Codec codec=Ds3Codec::None);
+    bool add(const std::string &name, const std::string &type, std::vector<std::uint8_t> &&byteArray, Ds3Codec codec=Ds3Codec::None);
+    bool add(const std::string &name, const std::string &type, size_t size, Producer producer);
+    bool keep(const Ds3ReaderItem &item);
     bool save(const std::string &filename);
+    bool saveIncrementally(const std::string &filename, long long binaryOffset);
+    void setHeadFormat(Ds3HeadFormat headFormat);
+    void setHeaderReserve(size_t headerReserve);
+    static const size_t m_chunkSize = 1024 * 1024;
 private:
-    std::map<std::string, Ds3WriterItem> m_itemsMap;
+    std::map<std::string, size_t> m_itemsMap;
     std::vector<Ds3WriterItem> m_items;
     std::string m_filename;
+    Ds3HeadFormat m_headFormat = Ds3HeadFormat::Xml;
+    size_t m_headerReserve = 0;
+    void encodeItems();
+    std::string makeXmlHeader(const std::vector<std::uint64_t> &offsets) const;
+    std::string makeBinaryHeader(const std::vector<std::uint64_t> &offsets) const;
+    std::string makeFileHead(const std::vector<std::uint64_t> &offsets, size_t reserveSize) const;
+    bool writePayload(std::ostream &file, Ds3WriterItem &writerItem, std::vector<std::uint8_t> &chunk);
 };
 
 }
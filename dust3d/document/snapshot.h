@@ -39,6 +39,7 @@ public:
     std::map<std::string, std::map<std::string, std::string>> components;
     std::map<std::string, std::string> rootComponent;
     std::vector<std::pair<std::map<std::string, std::string>, std::vector<std::pair<std::map<std::string, std::string>, std::vector<std::map<std::string, std::string>>>>>> materials; // std::pair<Material attributes, layers>  layer: std::pair<Layer attributes, maps>
+    std::string pendingMaterialsXml; // Unparsed <materials> element, kept when loading without SnapshotItem::Material, see snapshotMaterials()
 };
     
 }
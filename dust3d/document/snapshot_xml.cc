@@ -20,160 +20,201 @@
  *  SOFTWARE.
  */
 
-#include <stack>
-#include <iostream>
-#include <rapidxml.hpp>
+#include <algorithm>
+#include <cstring>
+#include <set>
 #include <hu/base/debug.h>
 #include <hu/base/string.h>
 #include <hu/base/uuid.h>
+#include <hu/base/xml_reader.h>
 #include <dust3d/document/snapshot_xml.h>
 
 namespace Dust3d
 {
 
-static std::string loadComponentReturnChildrenList(Snapshot *snapshot, rapidxml::xml_node<> *parentNode)
+// Saved files list attributes and rows in key order, so hinting at the end makes most inserts constant time. 
+// Every map node owns its key and value strings, so Snapshot leaves no room for interned names or arena 
+// storage; TypedSnapshot is the interned form
+static void loadAttributes(const Hu::XmlReader &reader, std::map<std::string, std::string> *map)
 {
-    std::vector<std::string> children;
-    for (rapidxml::xml_node<> *node = parentNode->first_node(); nullptr != node; node = node->next_sibling()) {
-        rapidxml::xml_attribute<> *idAttribute = node->first_attribute("id");
-        if (nullptr != idAttribute) {
-            std::string componentIdString = idAttribute->value();
-            children.push_back(componentIdString);
-            std::map<std::string, std::string> *componentMap = &snapshot->components[componentIdString];
-            for (rapidxml::xml_attribute<> *attribute = node->first_attribute();
-                    attribute; attribute = attribute->next_attribute()) {
-                (*componentMap)[attribute->name()] = attribute->value();
-            }
-            snapshot->components[componentIdString]["children"] = loadComponentReturnChildrenList(snapshot, node);
+    for (const auto &attribute: reader.attributes())
+        map->insert_or_assign(map->end(), std::string(attribute.name), std::string(attribute.value));
+}
+
+// Visit every child of the element just started. The handler has to consume the child, either by 
+// skipping it or by visiting its own children
+template <class Handler>
+static bool loadChildren(Hu::XmlReader &reader, Handler handler)
+{
+    size_t depth = reader.depth();
+    for (;;) {
+        switch (reader.next()) {
+        case Hu::XmlReader::Token::StartElement:
+            if (!handler())
+                return false;
+            break;
+        case Hu::XmlReader::Token::EndElement:
+            if (reader.depth() < depth)
+                return true;
+            break;
+        default:
+            return false;
         }
     }
-    return Hu::String::join(children, ",");
 }
 
-void loadSnapshotFromXmlString(Snapshot *snapshot, char *xmlString, uint32_t flags)
+static bool loadRows(Hu::XmlReader &reader, std::map<std::string, std::map<std::string, std::string>> *rows)
 {
-    try {
-        rapidxml::xml_document<> xml;
-        xml.parse<0>(xmlString);
-        rapidxml::xml_node<> *canvas = xml.first_node("canvas");
-        if (nullptr != canvas) {
-            if (flags & (uint32_t)SnapshotItem::Canvas) {
-                for (rapidxml::xml_attribute<> *attribute = canvas->first_attribute();
-                        attribute; attribute = attribute->next_attribute()) {
-                    snapshot->canvas[attribute->name()] = attribute->value();
-                }
-            }
-            if (flags & (uint32_t)SnapshotItem::Component) {
-                rapidxml::xml_node<> *nodes = canvas->first_node("nodes");
-                if (nullptr != nodes) {
-                    for (rapidxml::xml_node<> *node = nodes->first_node(); nullptr != node; node = node->next_sibling()) {
-                        rapidxml::xml_attribute<> *idAttribute = node->first_attribute("id");
-                        if (nullptr != idAttribute) {
-                            std::map<std::string, std::string> *nodeMap = &snapshot->nodes[idAttribute->value()];
-                            for (rapidxml::xml_attribute<> *attribute = node->first_attribute();
-                                    attribute; attribute = attribute->next_attribute()) {
-                                (*nodeMap)[attribute->name()] = attribute->value();
-                            }
-                        }
-                    }
-                }
-            }
-            if (flags & (uint32_t)SnapshotItem::Component) {
-                rapidxml::xml_node<> *edges = canvas->first_node("edges");
-                if (nullptr != edges) {
-                    for (rapidxml::xml_node<> *node = edges->first_node(); nullptr != node; node = node->next_sibling()) {
-                        rapidxml::xml_attribute<> *idAttribute = node->first_attribute("id");
-                        if (nullptr != idAttribute) {
-                            std::map<std::string, std::string> *edgeMap = &snapshot->edges[idAttribute->value()];
-                            for (rapidxml::xml_attribute<> *attribute = node->first_attribute();
-                                    attribute; attribute = attribute->next_attribute()) {
-                                (*edgeMap)[attribute->name()] = attribute->value();
-                            }
-                        }
-                    }
-                }
-            }
-            if (flags & (uint32_t)SnapshotItem::Component) {
-                rapidxml::xml_node<> *parts = canvas->first_node("parts");
-                if (nullptr != parts) {
-                    for (rapidxml::xml_node<> *node = parts->first_node(); nullptr != node; node = node->next_sibling()) {
-                        rapidxml::xml_attribute<> *idAttribute = node->first_attribute("id");
-                        if (nullptr != idAttribute) {
-                            std::map<std::string, std::string> *partMap = &snapshot->parts[idAttribute->value()];
-                            for (rapidxml::xml_attribute<> *attribute = node->first_attribute();
-                                    attribute; attribute = attribute->next_attribute()) {
-                                (*partMap)[attribute->name()] = attribute->value();
-                            }
-                        }
+    return loadChildren(reader, [&]() {
+        const Hu::XmlReader::Attribute *idAttribute = reader.findAttribute("id");
+        if (nullptr != idAttribute)
+            loadAttributes(reader, &rows->try_emplace(rows->end(), std::string(idAttribute->value))->second);
+        return reader.skipElement();
+    });
+}
+
+static bool loadComponentChildren(Hu::XmlReader &reader, Snapshot *snapshot, std::string *childrenIds)
+{
+    size_t childCount = 0;
+    return loadChildren(reader, [&]() {
+        const Hu::XmlReader::Attribute *idAttribute = reader.findAttribute("id");
+        if (nullptr == idAttribute)
+            return reader.skipElement();
+        std::string componentId(idAttribute->value);
+        if (childCount++ > 0)
+            *childrenIds += ",";
+        *childrenIds += componentId;
+        std::map<std::string, std::string> *componentMap = &snapshot->components[std::move(componentId)];
+        loadAttributes(reader, componentMap);
+        std::string children;
+        if (!loadComponentChildren(reader, snapshot, &children))
+            return false;
+        (*componentMap)["children"] = std::move(children);
+        return true;
+    });
+}
+
+// Only the first child with the given name is visited, others are skipped
+template <class Handler>
+static bool loadFirstChild(Hu::XmlReader &reader, std::string_view name, Handler handler)
+{
+    bool found = false;
+    return loadChildren(reader, [&]() {
+        if (found || reader.name() != name)
+            return reader.skipElement();
+        found = true;
+        return handler();
+    });
+}
+
+static bool loadMaterials(Hu::XmlReader &reader, Snapshot *snapshot)
+{
+    return loadChildren(reader, [&]() {
+        auto &currentMaterial = snapshot->materials.emplace_back();
+        loadAttributes(reader, &currentMaterial.first);
+        return loadFirstChild(reader, "layers", [&]() {
+            return loadFirstChild(reader, "layer", [&]() {
+                auto &currentMaterialLayer = currentMaterial.second.emplace_back();
+                loadAttributes(reader, &currentMaterialLayer.first);
+                return loadFirstChild(reader, "maps", [&]() {
+                    return loadChildren(reader, [&]() {
+                        loadAttributes(reader, &currentMaterialLayer.second.emplace_back());
+                        return reader.skipElement();
+                    });
+                });
+            });
+        });
+    });
+}
+
+static bool loadCanvas(Hu::XmlReader &reader, Snapshot *snapshot, uint32_t flags)
+{
+    if (flags & (uint32_t)SnapshotItem::Canvas)
+        loadAttributes(reader, &snapshot->canvas);
+    
+    // Nothing under the canvas element was asked for, leave the rest of the document unread
+    if (0 == (flags & ((uint32_t)SnapshotItem::Component | (uint32_t)SnapshotItem::Material)))
+        return true;
+    
+    // Sections are taken once each, in whatever order they appear. The components tree, 
+    // when present, decides the root children even if partIdList comes after it
+    std::set<std::string_view> loadedSections;
+    bool componentsLoaded = false;
+    std::string ignoredChildrenIds;
+    return loadChildren(reader, [&]() {
+        std::string_view section = reader.name();
+        if (!loadedSections.insert(section).second)
+            return reader.skipElement();
+        if (flags & (uint32_t)SnapshotItem::Component) {
+            if ("nodes" == section)
+                return loadRows(reader, &snapshot->nodes);
+            if ("edges" == section)
+                return loadRows(reader, &snapshot->edges);
+            if ("parts" == section)
+                return loadRows(reader, &snapshot->parts);
+            if ("partIdList" == section) {
+                return loadChildren(reader, [&]() {
+                    const Hu::XmlReader::Attribute *idAttribute = reader.findAttribute("id");
+                    if (nullptr != idAttribute) {
+                        std::string componentId = Hu::Uuid::createUuid().toString();
+                        auto &component = snapshot->components[componentId];
+                        component["id"] = componentId;
+                        component["linkData"] = idAttribute->value;
+                        component["linkDataType"] = "partId";
+                        auto &childrenIds = componentsLoaded ? ignoredChildrenIds : snapshot->rootComponent["children"];
+                        if (!childrenIds.empty())
+                            childrenIds += ",";
+                        childrenIds += componentId;
                     }
-                }
+                    return reader.skipElement();
+                });
             }
-            if (flags & (uint32_t)SnapshotItem::Component) {
-                rapidxml::xml_node<> *partIdList = canvas->first_node("partIdList");
-                if (nullptr != partIdList) {
-                    for (rapidxml::xml_node<> *partId = partIdList->first_node(); nullptr != partId; partId = partId->next_sibling()) {
-                        rapidxml::xml_attribute<> *idAttribute = partId->first_attribute("id");
-                        if (nullptr != idAttribute) {
-                            std::string componentId = Hu::Uuid::createUuid().toString();
-                            auto &component = snapshot->components[componentId];
-                            component["id"] = componentId;
-                            component["linkData"] = idAttribute->value();
-                            component["linkDataType"] = "partId";
-                            auto &childrenIds = snapshot->rootComponent["children"];
-                            if (!childrenIds.empty())
-                                childrenIds += ",";
-                            childrenIds += componentId;
-                        }
-                    }
-                }
+            if ("components" == section) {
+                componentsLoaded = true;
+                std::string childrenIds;
+                if (!loadComponentChildren(reader, snapshot, &childrenIds))
+                    return false;
+                snapshot->rootComponent["children"] = std::move(childrenIds);
+                return true;
             }
-            if (flags & (uint32_t)SnapshotItem::Component) {
-                rapidxml::xml_node<> *components = canvas->first_node("components");
-                if (nullptr != components) {
-                    snapshot->rootComponent["children"] = loadComponentReturnChildrenList(snapshot, components);
-                }
+        }
+        if ("materials" == section) {
+            if (flags & (uint32_t)SnapshotItem::Material)
+                return loadMaterials(reader, snapshot);
+            const char *begin = reader.elementBegin();
+            if (!reader.skipElement())
+                return false;
+            snapshot->pendingMaterialsXml.assign(begin, reader.position());
+            return true;
+        }
+        return reader.skipElement();
+    });
+}
+
+void loadSnapshotFromXmlString(Snapshot *snapshot, char *xmlString, uint32_t flags)
+{
+    try {
+        Hu::XmlReader reader(xmlString);
+        for (;;) {
+            Hu::XmlReader::Token token = reader.next();
+            if (Hu::XmlReader::Token::EndOfDocument == token)
+                break;
+            if (Hu::XmlReader::Token::StartElement != token || 1 != reader.depth()) {
+                huDebug << "Parse error was: " << reader.error();
+                break;
             }
-            if (flags & (uint32_t)SnapshotItem::Material) {
-                rapidxml::xml_node<> *materials = canvas->first_node("materials");
-                if (nullptr != materials) {
-                    for (rapidxml::xml_node<> *material = materials->first_node(); nullptr != material; material = material->next_sibling()) {
-                        std::pair<std::map<std::string, std::string>, std::vector<std::pair<std::map<std::string, std::string>, std::vector<std::map<std::string, std::string>>>>> currentMaterial;
-                        for (rapidxml::xml_attribute<> *attribute = material->first_attribute();
-                                attribute; attribute = attribute->next_attribute()) {
-                            currentMaterial.first[attribute->name()] = attribute->value();
-                        }
-                        rapidxml::xml_node<> *materialLayers = material->first_node("layers");
-                        if (nullptr != materialLayers) {
-                            rapidxml::xml_node<> *layer = materialLayers->first_node("layer");
-                            if (nullptr != layer) {
-                                std::pair<std::map<std::string, std::string>, std::vector<std::map<std::string, std::string>>> currentMaterialLayer;
-                                for (rapidxml::xml_attribute<> *attribute = layer->first_attribute();
-                                        attribute; attribute = attribute->next_attribute()) {
-                                    currentMaterialLayer.first[attribute->name()] = attribute->value();
-                                }
-                                rapidxml::xml_node<> *layerMaps = layer->first_node("maps");
-                                if (nullptr != layerMaps) {
-                                    for (rapidxml::xml_node<> *mapPerLayer = layerMaps->first_node(); nullptr != mapPerLayer; mapPerLayer = mapPerLayer->next_sibling()) {
-                                        std::map<std::string, std::string> mapAttributes;
-                                        for (rapidxml::xml_attribute<> *attribute = mapPerLayer->first_attribute();
-                                                attribute; attribute = attribute->next_attribute()) {
-                                            mapAttributes[attribute->name()] = attribute->value();
-                                        }
-                                        currentMaterialLayer.second.push_back(mapAttributes);
-                                    }
-                                }
-                                currentMaterial.second.push_back(currentMaterialLayer);
-                            }
-                        }
-                        snapshot->materials.push_back(currentMaterial);
-                    }
-                }
+            bool isCanvas = "canvas" == reader.name();
+            bool loaded = isCanvas ? 
+                loadCanvas(reader, snapshot, flags) : 
+                reader.skipElement();
+            if (!loaded) {
+                huDebug << "Parse error was: " << reader.error();
+                break;
             }
+            // Only the first canvas counts, no need to read what follows it
+            if (isCanvas)
+                break;
         }
-    } catch (const std::runtime_error &e) {
-        huDebug << "Runtime error was: " << e.what();
-    } catch (const rapidxml::parse_error &e) {
-        huDebug << "Parse error was: " << e.what();
     } catch (const std::exception &e) {
         huDebug << "Error was: " << e.what();
     } catch (...) {
@@ -181,136 +222,238 @@ void loadSnapshotFromXmlString(Snapshot *snapshot, char *xmlString, uint32_t fla
     }
 }
 
-static void saveSnapshotComponent(const Snapshot &snapshot, std::string &xmlString, const std::string &componentId, int depth)
+const decltype(Snapshot::materials) &snapshotMaterials(Snapshot *snapshot)
 {
-    const auto findComponent = snapshot.components.find(componentId);
-    if (findComponent == snapshot.components.end())
-        return;
-    auto &component = findComponent->second;
-    std::string prefix(depth, ' ');
-    xmlString += prefix;
-    xmlString += "  <component";
-    std::map<std::string, std::string>::const_iterator componentAttributeIterator;
-    std::string children;
-    for (componentAttributeIterator = component.begin(); componentAttributeIterator != component.end(); componentAttributeIterator++) {
-        if ("children" == componentAttributeIterator->first) {
-            children = componentAttributeIterator->second;
-            continue;
-        }
-        if (Hu::String::startsWith(componentAttributeIterator->first, "__"))
-            continue;
-        xmlString += " " + componentAttributeIterator->first + "=\"" + componentAttributeIterator->second + "\"";
+    if (snapshot->pendingMaterialsXml.empty())
+        return snapshot->materials;
+    std::string xmlString = std::move(snapshot->pendingMaterialsXml);
+    snapshot->pendingMaterialsXml.clear();
+    Hu::XmlReader reader(xmlString.data());
+    if (Hu::XmlReader::Token::StartElement != reader.next() || !loadMaterials(reader, snapshot))
+        huDebug << "Parse error was: " << reader.error();
+    return snapshot->materials;
+}
+
+// Appends straight into the string's storage, which is grown ahead and trimmed to size at the end
+class SnapshotXmlWriter
+{
+public:
+    SnapshotXmlWriter(std::string &xmlString, size_t reserveSize):
+        m_xmlString(xmlString),
+        m_size(xmlString.size())
+    {
+        m_xmlString.resize(m_size + reserveSize);
+    }
+    
+    ~SnapshotXmlWriter()
+    {
+        m_xmlString.resize(m_size);
     }
-    xmlString += ">\n";
-    if (!children.empty()) {
-        for (const auto &childId: Hu::String::split(children, ',')) {
-            if (childId.empty())
+    
+    void append(const char *data, size_t size)
+    {
+        if (m_size + size > m_xmlString.size())
+            m_xmlString.resize(std::max(m_xmlString.size() * 2, m_size + size));
+        std::memcpy(m_xmlString.data() + m_size, data, size);
+        m_size += size;
+    }
+    
+    void append(std::string_view string)
+    {
+        append(string.data(), string.size());
+    }
+    
+    void append(size_t count, char c)
+    {
+        if (m_size + count > m_xmlString.size())
+            m_xmlString.resize(std::max(m_xmlString.size() * 2, m_size + count));
+        std::memset(m_xmlString.data() + m_size, c, count);
+        m_size += count;
+    }
+    
+    void appendAttribute(const std::string &key, const std::string &value)
+    {
+        append(" ", 1);
+        append(key);
+        append("=\"", 2);
+        append(value);
+        append("\"", 1);
+    }
+    
+    void appendAttributes(const std::map<std::string, std::string> &attributes, bool skipInternal=false)
+    {
+        for (const auto &it: attributes) {
+            if (skipInternal && Hu::String::startsWith(it.first, "__"))
                 continue;
-            saveSnapshotComponent(snapshot, xmlString, childId, depth + 1);
+            appendAttribute(it.first, it.second);
         }
     }
-    xmlString += prefix;
-    xmlString += "  </component>\n";
+    
+    void appendRows(std::string_view tag, const std::map<std::string, std::map<std::string, std::string>> &rows, bool skipInternal=false)
+    {
+        for (const auto &row: rows) {
+            append(tag);
+            appendAttributes(row.second, skipInternal);
+            append("/>\n", 3);
+        }
+    }
+    
+private:
+    std::string &m_xmlString;
+    size_t m_size = 0;
+};
+
+static size_t estimateAttributesSize(const std::map<std::string, std::string> &attributes)
+{
+    size_t size = 0;
+    for (const auto &it: attributes)
+        size += it.first.size() + it.second.size() + sizeof(" =\"\"") - 1;
+    return size;
 }
 
-void saveSnapshotToXmlString(const Snapshot &snapshot, std::string &xmlString)
+// Walking every row only to size the buffer costs about as much as writing it, so sample the first ones
+static size_t estimateRowsSize(const std::map<std::string, std::map<std::string, std::string>> &rows, size_t tagSize)
 {
-    xmlString += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
-    
-    xmlString += "<canvas";
-        std::map<std::string, std::string>::const_iterator canvasIterator;
-        for (canvasIterator = snapshot.canvas.begin(); canvasIterator != snapshot.canvas.end(); canvasIterator++) {
-            xmlString += " " + canvasIterator->first + "=\"" + canvasIterator->second + "\"";
+    const size_t maxSampleCount = 32;
+    size_t sampleCount = 0;
+    size_t sampleSize = 0;
+    for (auto it = rows.begin(); it != rows.end() && sampleCount < maxSampleCount; ++it, ++sampleCount)
+        sampleSize += tagSize + estimateAttributesSize(it->second);
+    if (0 == sampleCount)
+        return 0;
+    return sampleSize * rows.size() / sampleCount;
+}
+
+// Not an upper bound, only close enough to avoid regrowing the buffer on large models
+static size_t estimateSnapshotXmlSize(const Snapshot &snapshot)
+{
+    size_t size = 256 + estimateAttributesSize(snapshot.canvas);
+    size += estimateRowsSize(snapshot.nodes, sizeof("  <node/>\n"));
+    size += estimateRowsSize(snapshot.edges, sizeof("  <edge/>\n"));
+    size += estimateRowsSize(snapshot.parts, sizeof("  <part/>\n"));
+    size += estimateRowsSize(snapshot.components, sizeof("  <component>\n  </component>\n") + 16);
+    for (const auto &material: snapshot.materials) {
+        size += 64 + estimateAttributesSize(material.first);
+        for (const auto &layer: material.second) {
+            size += 64 + estimateAttributesSize(layer.first);
+            for (const auto &map: layer.second)
+                size += sizeof("      <map/>\n") + estimateAttributesSize(map);
         }
-        xmlString += ">\n";
+    }
+    return size;
+}
 
-        xmlString += " <nodes>\n";
-        std::map<std::string, std::map<std::string, std::string>>::const_iterator nodeIterator;
-        for (nodeIterator = snapshot.nodes.begin(); nodeIterator != snapshot.nodes.end(); nodeIterator++) {
-            std::map<std::string, std::string>::const_iterator nodeAttributeIterator;
-            xmlString += "  <node";
-            for (nodeAttributeIterator = nodeIterator->second.begin(); nodeAttributeIterator != nodeIterator->second.end(); nodeAttributeIterator++) {
-                xmlString += " " + nodeAttributeIterator->first + "=\"" + nodeAttributeIterator->second + "\"";
+// Take the next non empty id from a comma separated list, the same items Hu::String::split would give
+static bool nextChildId(std::string_view children, size_t *position, std::string_view *childId)
+{
+    while (*position < children.size()) {
+        size_t end = children.find(',', *position);
+        if (std::string_view::npos == end)
+            end = children.size();
+        *childId = children.substr(*position, end - *position);
+        *position = end + 1;
+        if (!childId->empty())
+            return true;
+    }
+    return false;
+}
+
+static void saveSnapshotComponents(const Snapshot &snapshot, SnapshotXmlWriter &writer, std::string_view rootChildren)
+{
+    struct Frame
+    {
+        std::string_view children;
+        size_t position;
+        int depth;
+    };
+    std::vector<Frame> frames;
+    frames.push_back({rootChildren, 0, -1});
+    while (!frames.empty()) {
+        Frame &frame = frames.back();
+        std::string_view childId;
+        if (!nextChildId(frame.children, &frame.position, &childId)) {
+            if (frame.depth >= 0) {
+                writer.append(frame.depth, ' ');
+                writer.append("  </component>\n", 15);
             }
-            xmlString += "/>\n";
+            frames.pop_back();
+            continue;
         }
-        xmlString += " </nodes>\n";
-    
-        xmlString += " <edges>\n";
-        std::map<std::string, std::map<std::string, std::string>>::const_iterator edgeIterator;
-        for (edgeIterator = snapshot.edges.begin(); edgeIterator != snapshot.edges.end(); edgeIterator++) {
-            std::map<std::string, std::string>::const_iterator edgeAttributeIterator;
-            xmlString += "  <edge";
-            for (edgeAttributeIterator = edgeIterator->second.begin(); edgeAttributeIterator != edgeIterator->second.end(); edgeAttributeIterator++) {
-                xmlString += " " + edgeAttributeIterator->first + "=\"" + edgeAttributeIterator->second + "\"";
+        int depth = frame.depth + 1;
+        const auto findComponent = snapshot.components.find(std::string(childId));
+        if (findComponent == snapshot.components.end())
+            continue;
+        std::string_view children;
+        writer.append(depth, ' ');
+        writer.append("  <component", 12);
+        for (const auto &it: findComponent->second) {
+            if ("children" == it.first) {
+                children = it.second;
+                continue;
             }
-            xmlString += "/>\n";
+            if (Hu::String::startsWith(it.first, "__"))
+                continue;
+            writer.appendAttribute(it.first, it.second);
         }
-        xmlString += " </edges>\n";
+        writer.append(">\n", 2);
+        frames.push_back({children, 0, depth});
+    }
+}
+
+void saveSnapshotToXmlString(const Snapshot &snapshot, std::string &xmlString)
+{
+    SnapshotXmlWriter writer(xmlString, estimateSnapshotXmlSize(snapshot));
     
-        xmlString += " <parts>\n";
-        std::map<std::string, std::map<std::string, std::string>>::const_iterator partIterator;
-        for (partIterator = snapshot.parts.begin(); partIterator != snapshot.parts.end(); partIterator++) {
-            std::map<std::string, std::string>::const_iterator partAttributeIterator;
-            xmlString += "  <part";
-            for (partAttributeIterator = partIterator->second.begin(); partAttributeIterator != partIterator->second.end(); partAttributeIterator++) {
-                if (Hu::String::startsWith(partAttributeIterator->first, "__"))
-                    continue;
-                xmlString += " " + partAttributeIterator->first + "=\"" + partAttributeIterator->second + "\"";
-            }
-            xmlString += "/>\n";
-        }
-        xmlString += " </parts>\n";
+    writer.append("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    
+    writer.append("<canvas");
+        writer.appendAttributes(snapshot.canvas);
+        writer.append(">\n");
+
+        writer.append(" <nodes>\n");
+        writer.appendRows("  <node", snapshot.nodes);
+        writer.append(" </nodes>\n");
+    
+        writer.append(" <edges>\n");
+        writer.appendRows("  <edge", snapshot.edges);
+        writer.append(" </edges>\n");
+    
+        writer.append(" <parts>\n");
+        writer.appendRows("  <part", snapshot.parts, true);
+        writer.append(" </parts>\n");
     
         const auto &childrenIds = snapshot.rootComponent.find("children");
         if (childrenIds != snapshot.rootComponent.end()) {
-            xmlString += " <components>\n";
-            for (const auto &componentId: Hu::String::split(childrenIds->second, ',')) {
-                if (componentId.empty())
-                    continue;
-                saveSnapshotComponent(snapshot, xmlString, componentId, 0);
-            }
-            xmlString += " </components>\n";
+            writer.append(" <components>\n");
+            saveSnapshotComponents(snapshot, writer, childrenIds->second);
+            writer.append(" </components>\n");
         }
     
-        xmlString += " <materials>\n";
-        std::vector<std::pair<std::map<std::string, std::string>, std::vector<std::pair<std::map<std::string, std::string>, std::vector<std::map<std::string, std::string>>>>>>::const_iterator materialIterator;
-        for (materialIterator = snapshot.materials.begin(); materialIterator != snapshot.materials.end(); materialIterator++) {
-            std::map<std::string, std::string>::const_iterator materialAttributeIterator;
-            xmlString += "  <material";
-                for (materialAttributeIterator = materialIterator->first.begin(); materialAttributeIterator != materialIterator->first.end(); materialAttributeIterator++) {
-                    xmlString += " " + materialAttributeIterator->first + "=\"" + materialAttributeIterator->second + "\"";
-                }
-                xmlString += ">\n";
-                xmlString += "   <layers>\n";
-                std::vector<std::pair<std::map<std::string, std::string>, std::vector<std::map<std::string, std::string>>>>::const_iterator layerIterator;
-                for (layerIterator = materialIterator->second.begin(); layerIterator != materialIterator->second.end(); layerIterator++) {
-                    std::map<std::string, std::string>::const_iterator layerAttributeIterator;
-                    xmlString += "    <layer";
-                        for (layerAttributeIterator = layerIterator->first.begin(); layerAttributeIterator != layerIterator->first.end(); layerAttributeIterator++) {
-                            xmlString += " " + layerAttributeIterator->first + "=\"" + layerAttributeIterator->second + "\"";
-                        }
-                        xmlString += ">\n";
-                        xmlString += "     <maps>\n";
-                        std::vector<std::map<std::string, std::string>>::const_iterator mapIterator;
-                        for (mapIterator = layerIterator->second.begin(); mapIterator != layerIterator->second.end(); mapIterator++) {
-                            std::map<std::string, std::string>::const_iterator attributesIterator;
-                            xmlString += "      <map";
-                            for (attributesIterator = mapIterator->begin(); attributesIterator != mapIterator->end();
-                                    attributesIterator++) {
-                                xmlString += " " + attributesIterator->first + "=\"" + attributesIterator->second + "\"";
-                            }
-                            xmlString += "/>\n";
+        writer.append(" <materials>\n");
+        for (const auto &material: snapshot.materials) {
+            writer.append("  <material");
+                writer.appendAttributes(material.first);
+                writer.append(">\n");
+                writer.append("   <layers>\n");
+                for (const auto &layer: material.second) {
+                    writer.append("    <layer");
+                        writer.appendAttributes(layer.first);
+                        writer.append(">\n");
+                        writer.append("     <maps>\n");
+                        for (const auto &map: layer.second) {
+                            writer.append("      <map");
+                            writer.appendAttributes(map);
+                            writer.append("/>\n");
                         }
-                        xmlString += "     </maps>\n";
-                    xmlString += "    </layer>\n";
+                        writer.append("     </maps>\n");
+                    writer.append("    </layer>\n");
                 }
-                xmlString += "  </layers>\n";
-            xmlString += "  </material>\n";
+                writer.append("  </layers>\n");
+            writer.append("  </material>\n");
         }
-        xmlString += " </materials>\n";
+        writer.append(" </materials>\n");
     
-    xmlString += "</canvas>\n";
+    writer.append("</canvas>\n");
 }
 
 }
@@ -44,6 +44,7 @@ enum class SnapshotItem
 void loadSnapshotFromXmlString(Snapshot *snapshot, char *xmlString, 
     uint32_t flags=(uint32_t)SnapshotItem::All);
 void saveSnapshotToXmlString(const Snapshot &snapshot, std::string &xmlString);
+const decltype(Snapshot::materials) &snapshotMaterials(Snapshot *snapshot);
     
 }
 
@@ -0,0 +1,309 @@
+/*
+ *  Copyright (c) 2016-2022 Jeremy HU <jeremy-at-dust3d dot org>. All rights reserved. 
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include <charconv>
+#include <dust3d/document/typed_snapshot.h>
+
+namespace Dust3d
+{
+
+static int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+bool SnapshotUuid::parse(std::string_view string, SnapshotUuid *uuid)
+{
+    // Only the lowercase form we write ourselves, anything else stays a string and round trips untouched
+    if (sizeof("hhhhhhhh-hhhh-hhhh-hhhh-hhhhhhhhhhhh") - 1 != string.length())
+        return false;
+    std::uint64_t parts[2] = {0, 0};
+    int nibbles = 0;
+    for (size_t i = 0; i < string.length(); ++i) {
+        if (8 == i || 13 == i || 18 == i || 23 == i) {
+            if ('-' != string[i])
+                return false;
+            continue;
+        }
+        int digit = hexDigit(string[i]);
+        if (-1 == digit)
+            return false;
+        std::uint64_t &part = parts[nibbles / 16];
+        part = (part << 4) | (std::uint64_t)digit;
+        ++nibbles;
+    }
+    uuid->high = parts[0];
+    uuid->low = parts[1];
+    return true;
+}
+
+void SnapshotUuid::appendTo(std::string &string) const
+{
+    static const char *digits = "0123456789abcdef";
+    char buffer[36];
+    int nibble = 0;
+    for (size_t i = 0; i < sizeof(buffer); ++i) {
+        if (8 == i || 13 == i || 18 == i || 23 == i) {
+            buffer[i] = '-';
+            continue;
+        }
+        std::uint64_t part = nibble < 16 ? high : low;
+        buffer[i] = digits[(part >> ((15 - nibble % 16) * 4)) & 0xf];
+        ++nibble;
+    }
+    string.append(buffer, sizeof(buffer));
+}
+
+std::string SnapshotUuid::toString() const
+{
+    std::string string;
+    appendTo(string);
+    return string;
+}
+
+static bool parseNumber(std::string_view string, double *number, std::uint8_t *decimals)
+{
+    // Plain fixed notation only, and only if printing it back gives the same characters
+    if (string.empty() || string.length() > 24)
+        return false;
+    size_t i = '-' == string[0] ? 1 : 0;
+    size_t integerBegin = i;
+    while (i < string.length() && string[i] >= '0' && string[i] <= '9')
+        ++i;
+    if (i == integerBegin)
+        return false;
+    size_t fractionDigits = 0;
+    if (i < string.length() && '.' == string[i]) {
+        ++i;
+        size_t fractionBegin = i;
+        while (i < string.length() && string[i] >= '0' && string[i] <= '9')
+            ++i;
+        fractionDigits = i - fractionBegin;
+        if (0 == fractionDigits)
+            return false;
+    }
+    if (i != string.length() || fractionDigits > 17)
+        return false;
+    
+    double value = 0.0;
+    auto parsed = std::from_chars(string.data(), string.data() + string.length(), value);
+    if (parsed.ec != std::errc() || parsed.ptr != string.data() + string.length())
+        return false;
+    
+    char buffer[64];
+    auto printed = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, (int)fractionDigits);
+    if (printed.ec != std::errc() || std::string_view(buffer, printed.ptr - buffer) != string)
+        return false;
+    
+    *number = value;
+    *decimals = (std::uint8_t)fractionDigits;
+    return true;
+}
+
+void TypedSnapshot::clear()
+{
+    for (Table *table: {&canvas, &nodes, &edges, &parts, &components, &rootComponent, &materials, &materialLayers, &materialMaps})
+        *table = Table();
+    m_stringMap.clear();
+    m_strings.clear();
+    m_uuids.clear();
+}
+
+std::uint32_t TypedSnapshot::intern(std::string_view string)
+{
+    auto findString = m_stringMap.find(string);
+    if (findString != m_stringMap.end())
+        return findString->second;
+    std::uint32_t index = (std::uint32_t)m_strings.size();
+    m_strings.emplace_back(string);
+    m_stringMap.insert({std::string_view(m_strings.back()), index});
+    return index;
+}
+
+bool TypedSnapshot::findString(std::string_view string, std::uint32_t *index) const
+{
+    auto findString = m_stringMap.find(string);
+    if (findString == m_stringMap.end())
+        return false;
+    *index = findString->second;
+    return true;
+}
+
+SnapshotValue TypedSnapshot::makeValue(std::uint32_t key, std::string_view string)
+{
+    SnapshotValue value;
+    value.key = key;
+    SnapshotUuid uuid;
+    if (SnapshotUuid::parse(string, &uuid)) {
+        value.type = SnapshotValueType::Uuid;
+        value.index = (std::uint32_t)m_uuids.size();
+        m_uuids.push_back(uuid);
+        return value;
+    }
+    double number = 0.0;
+    std::uint8_t decimals = 0;
+    if (parseNumber(string, &number, &decimals)) {
+        value.type = SnapshotValueType::Number;
+        value.decimals = decimals;
+        value.number = number;
+        return value;
+    }
+    value.type = SnapshotValueType::String;
+    value.index = intern(string);
+    return value;
+}
+
+void TypedSnapshot::appendValueString(const SnapshotValue &value, std::string &string) const
+{
+    switch (value.type) {
+    case SnapshotValueType::Uuid:
+        m_uuids[value.index].appendTo(string);
+        break;
+    case SnapshotValueType::Number: {
+            char buffer[64];
+            auto printed = std::to_chars(buffer, buffer + sizeof(buffer), value.number, std::chars_format::fixed, (int)value.decimals);
+            string.append(buffer, printed.ptr - buffer);
+        }
+        break;
+    default:
+        string += m_strings[value.index];
+        break;
+    }
+}
+
+std::string TypedSnapshot::valueString(const SnapshotValue &value) const
+{
+    std::string string;
+    appendValueString(value, string);
+    return string;
+}
+
+double TypedSnapshot::valueNumber(const SnapshotValue &value) const
+{
+    if (SnapshotValueType::Number == value.type)
+        return value.number;
+    if (SnapshotValueType::String == value.type) {
+        const std::string &string = m_strings[value.index];
+        double number = 0.0;
+        std::from_chars(string.data(), string.data() + string.length(), number);
+        return number;
+    }
+    return 0.0;
+}
+
+void TypedSnapshot::addRow(Table *table, const SnapshotValue &key, std::uint32_t parent)
+{
+    table->m_keys.push_back(key);
+    table->m_parents.push_back(parent);
+    table->m_rowBegins.push_back((std::uint32_t)table->m_values.size());
+}
+
+void TypedSnapshot::addValue(Table *table, std::string_view key, std::string_view value)
+{
+    table->m_values.push_back(makeValue(intern(key), value));
+    table->m_rowBegins.back() = (std::uint32_t)table->m_values.size();
+}
+
+void TypedSnapshot::addRow(Table *table, const std::map<std::string, std::string> &attributes, std::uint32_t parent)
+{
+    addRow(table, SnapshotValue(), parent);
+    table->m_values.reserve(table->m_values.size() + attributes.size());
+    for (const auto &it: attributes)
+        addValue(table, it.first, it.second);
+}
+
+void TypedSnapshot::addRows(Table *table, const std::map<std::string, std::map<std::string, std::string>> &rows)
+{
+    table->m_keys.reserve(rows.size());
+    table->m_parents.reserve(rows.size());
+    table->m_rowBegins.reserve(rows.size() + 1);
+    for (const auto &row: rows) {
+        addRow(table, makeValue(0, row.first));
+        for (const auto &it: row.second)
+            addValue(table, it.first, it.second);
+    }
+}
+
+void TypedSnapshot::fromSnapshot(const Snapshot &snapshot)
+{
+    clear();
+    addRow(&canvas, snapshot.canvas);
+    addRows(&nodes, snapshot.nodes);
+    addRows(&edges, snapshot.edges);
+    addRows(&parts, snapshot.parts);
+    addRows(&components, snapshot.components);
+    addRow(&rootComponent, snapshot.rootComponent);
+    for (const auto &material: snapshot.materials) {
+        std::uint32_t materialRow = (std::uint32_t)materials.rowCount();
+        addRow(&materials, material.first);
+        for (const auto &layer: material.second) {
+            std::uint32_t layerRow = (std::uint32_t)materialLayers.rowCount();
+            addRow(&materialLayers, layer.first, materialRow);
+            for (const auto &map: layer.second)
+                addRow(&materialMaps, map, layerRow);
+        }
+    }
+}
+
+void TypedSnapshot::toMap(const Table &table, size_t row, std::map<std::string, std::string> *map) const
+{
+    for (const auto &value: table.values(row))
+        appendValueString(value, (*map)[m_strings[value.key]]);
+}
+
+void TypedSnapshot::toMaps(const Table &table, std::map<std::string, std::map<std::string, std::string>> *maps) const
+{
+    for (size_t row = 0; row < table.rowCount(); ++row)
+        toMap(table, row, &(*maps)[valueString(table.key(row))]);
+}
+
+void TypedSnapshot::toSnapshot(Snapshot *snapshot) const
+{
+    if (canvas.rowCount() > 0)
+        toMap(canvas, 0, &snapshot->canvas);
+    toMaps(nodes, &snapshot->nodes);
+    toMaps(edges, &snapshot->edges);
+    toMaps(parts, &snapshot->parts);
+    toMaps(components, &snapshot->components);
+    if (rootComponent.rowCount() > 0)
+        toMap(rootComponent, 0, &snapshot->rootComponent);
+    
+    // Layers and maps were added in the order of their parents, so walking them once rebuilds the nesting
+    size_t layerRow = 0;
+    size_t mapRow = 0;
+    for (size_t materialRow = 0; materialRow < materials.rowCount(); ++materialRow) {
+        auto &material = snapshot->materials.emplace_back();
+        toMap(materials, materialRow, &material.first);
+        for (; layerRow < materialLayers.rowCount() && materialLayers.parent(layerRow) == materialRow; ++layerRow) {
+            auto &layer = material.second.emplace_back();
+            toMap(materialLayers, layerRow, &layer.first);
+            for (; mapRow < materialMaps.rowCount() && materialMaps.parent(mapRow) == layerRow; ++mapRow)
+                toMap(materialMaps, mapRow, &layer.second.emplace_back());
+        }
+    }
+}
+
+}
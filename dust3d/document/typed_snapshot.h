@@ -0,0 +1,176 @@
+/*
+ *  Copyright (c) 2016-2022 Jeremy HU <jeremy-at-dust3d dot org>. All rights reserved. 
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#ifndef DUST3D_DOCUMENT_TYPED_SNAPSHOT_H_
+#define DUST3D_DOCUMENT_TYPED_SNAPSHOT_H_
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <unordered_map>
+#include <dust3d/document/snapshot.h>
+
+namespace Dust3d
+{
+
+struct SnapshotUuid
+{
+    std::uint64_t high = 0;
+    std::uint64_t low = 0;
+    
+    static bool parse(std::string_view string, SnapshotUuid *uuid);
+    void appendTo(std::string &string) const;
+    std::string toString() const;
+};
+
+inline bool operator==(const SnapshotUuid &left, const SnapshotUuid &right)
+{
+    return left.high == right.high && left.low == right.low;
+}
+
+inline bool operator<(const SnapshotUuid &left, const SnapshotUuid &right)
+{
+    return left.high < right.high || (left.high == right.high && left.low < right.low);
+}
+
+enum class SnapshotValueType : std::uint8_t
+{
+    String = 0,
+    Number,
+    Uuid
+};
+
+// One attribute or row key, 16 bytes. Numbers keep the count of decimals they were written with, 
+// so converting back gives the exact text we read
+struct SnapshotValue
+{
+    std::uint32_t key = 0;
+    SnapshotValueType type = SnapshotValueType::String;
+    std::uint8_t decimals = 0;
+    std::uint16_t reserved = 0;
+    union
+    {
+        double number;
+        std::uint32_t index = 0;
+    };
+};
+
+class TypedSnapshot
+{
+public:
+    static const std::uint32_t m_noParent = 0xffffffff;
+    
+    // Rows are stored back to back: row i owns values [m_rowBegins[i], m_rowBegins[i + 1])
+    class Table
+    {
+    public:
+        size_t rowCount() const
+        {
+            return m_keys.size();
+        }
+        
+        const SnapshotValue &key(size_t row) const
+        {
+            return m_keys[row];
+        }
+        
+        std::uint32_t parent(size_t row) const
+        {
+            return m_parents[row];
+        }
+        
+        std::span<const SnapshotValue> values(size_t row) const
+        {
+            return std::span<const SnapshotValue>(m_values.data() + m_rowBegins[row], m_rowBegins[row + 1] - m_rowBegins[row]);
+        }
+        
+        const SnapshotValue *findValue(size_t row, std::uint32_t key) const
+        {
+            for (const auto &value: values(row)) {
+                if (value.key == key)
+                    return &value;
+            }
+            return nullptr;
+        }
+        
+    private:
+        friend class TypedSnapshot;
+        
+        std::vector<SnapshotValue> m_keys;
+        std::vector<std::uint32_t> m_parents;
+        std::vector<std::uint32_t> m_rowBegins = {0};
+        std::vector<SnapshotValue> m_values;
+    };
+    
+    Table canvas;
+    Table nodes;
+    Table edges;
+    Table parts;
+    Table components;
+    Table rootComponent;
+    Table materials;
+    Table materialLayers;  // parent: row in materials
+    Table materialMaps;    // parent: row in materialLayers
+    
+    TypedSnapshot() = default;
+    TypedSnapshot(const TypedSnapshot &) = delete;
+    TypedSnapshot &operator=(const TypedSnapshot &) = delete;
+    
+    void fromSnapshot(const Snapshot &snapshot);
+    void toSnapshot(Snapshot *snapshot) const;
+    void clear();
+    
+    std::uint32_t intern(std::string_view string);
+    bool findString(std::string_view string, std::uint32_t *index) const;
+    const std::string &string(std::uint32_t index) const
+    {
+        return m_strings[index];
+    }
+    const SnapshotUuid &uuid(const SnapshotValue &value) const
+    {
+        return m_uuids[value.index];
+    }
+    SnapshotValue makeValue(std::uint32_t key, std::string_view string);
+    void appendValueString(const SnapshotValue &value, std::string &string) const;
+    std::string valueString(const SnapshotValue &value) const;
+    double valueNumber(const SnapshotValue &value) const;
+    
+    void addRow(Table *table, const SnapshotValue &key, std::uint32_t parent=m_noParent);
+    void addValue(Table *table, std::string_view key, std::string_view value);
+    
+private:
+    std::deque<std::string> m_strings;
+    std::unordered_map<std::string_view, std::uint32_t> m_stringMap;
+    std::vector<SnapshotUuid> m_uuids;
+    
+    void addRows(Table *table, const std::map<std::string, std::map<std::string, std::string>> &rows);
+    void addRow(Table *table, const std::map<std::string, std::string> &attributes, std::uint32_t parent=m_noParent);
+    void toMap(const Table &table, size_t row, std::map<std::string, std::string> *map) const;
+    void toMaps(const Table &table, std::map<std::string, std::map<std::string, std::string>> *maps) const;
+};
+
+}
+
+#endif
@@ -23,69 +23,207 @@
 #ifndef DUST3D_MESH_MESH_UTILS_H_
 #define DUST3D_MESH_MESH_UTILS_H_
 
+#include <cmath>
+#include <vector>
+#include <hu/base/math.h>
+#include <hu/base/parallel_for.h>
+#include <hu/base/vector3.h>
+
 namespace Dust3d
 {
 
 class MeshUtils
 {
 public:
-    static void smoothNormal(const std::vector<Vector3> &vertices,
+    // Corners are numbered in triangle order, skipping non triangles and out of range vertices. 
+    // Corners of vertex v are vertexCorners[vertexCornerBegins[v]] ... vertexCorners[vertexCornerBegins[v + 1] - 1], 
+    // corners of triangle t start at triangleCornerBegins[t]
+    struct CornerAdjacency
+    {
+        std::vector<size_t> triangleCornerBegins;
+        std::vector<size_t> vertexCornerBegins;
+        std::vector<size_t> vertexCorners;
+        std::vector<size_t> cornerTriangles;
+    };
+    
+    static void buildCornerAdjacency(size_t vertexCount,
         const std::vector<std::vector<size_t>> &triangles,
-        const std::vector<Vector3> &triangleNormals,
-        double thresholdAngle,
-        std::vector<Vector3> &triangleVertexNormals)
+        CornerAdjacency *adjacency)
     {
-        std::vector<std::vector<std::pair<size_t, size_t>>> triangleVertexNormalsMapByIndices(vertices.size());
-        std::vector<Vector3> angleAreaWeightedNormals;
+        adjacency->triangleCornerBegins.resize(triangles.size() + 1);
+        adjacency->vertexCornerBegins.assign(vertexCount + 1, 0);
+        adjacency->cornerTriangles.clear();
+        adjacency->cornerTriangles.reserve(triangles.size() * 3);
+        std::vector<size_t> cornerVertices;
+        cornerVertices.reserve(triangles.size() * 3);
         for (size_t triangleIndex = 0; triangleIndex < triangles.size(); ++triangleIndex) {
+            adjacency->triangleCornerBegins[triangleIndex] = cornerVertices.size();
             const auto &sourceTriangle = triangles[triangleIndex];
-            if (sourceTriangle.size() != 3) {
+            if (sourceTriangle.size() != 3)
                 continue;
+            for (int i = 0; i < 3; ++i) {
+                if (sourceTriangle[i] >= vertexCount)
+                    continue;
+                ++adjacency->vertexCornerBegins[sourceTriangle[i] + 1];
+                cornerVertices.push_back(sourceTriangle[i]);
+                adjacency->cornerTriangles.push_back(triangleIndex);
             }
+        }
+        adjacency->triangleCornerBegins[triangles.size()] = cornerVertices.size();
+        for (size_t vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex)
+            adjacency->vertexCornerBegins[vertexIndex + 1] += adjacency->vertexCornerBegins[vertexIndex];
+        std::vector<size_t> nextCorners(adjacency->vertexCornerBegins.begin(), adjacency->vertexCornerBegins.end() - 1);
+        adjacency->vertexCorners.resize(cornerVertices.size());
+        for (size_t corner = 0; corner < cornerVertices.size(); ++corner)
+            adjacency->vertexCorners[nextCorners[cornerVertices[corner]]++] = corner;
+    }
+    
+    static void smoothNormal(const std::vector<Hu::Vector3> &vertices,
+        const std::vector<std::vector<size_t>> &triangles,
+        const std::vector<Hu::Vector3> &triangleNormals,
+        double thresholdAngle,
+        std::vector<Hu::Vector3> &triangleVertexNormals)
+    {
+        CornerAdjacency adjacency;
+        std::vector<Hu::Vector3> angleAreaWeightedNormals;
+        std::vector<Hu::Vector3> unitTriangleNormals;
+        buildCornerAdjacency(vertices.size(), triangles, &adjacency);
+        angleAreaWeightedNormals.resize(adjacency.cornerTriangles.size());
+        unitTriangleNormals.resize(triangles.size());
+        weightCornerNormals(0, triangles.size(), vertices, triangles, triangleNormals, adjacency, 
+            angleAreaWeightedNormals, unitTriangleNormals);
+        triangleVertexNormals.resize(angleAreaWeightedNormals.size());
+        smoothVertexNormals(0, vertices.size(), adjacency, angleAreaWeightedNormals, unitTriangleNormals, 
+            minDotProduct(thresholdAngle), triangleVertexNormals);
+    }
+    
+    // Same result as smoothNormal, with corner weighting and per vertex smoothing split into 
+    // blocks over up to maxThreads threads of the shared pool (0 means all of them). Each block writes its own range
+    static void smoothNormalParallel(const std::vector<Hu::Vector3> &vertices,
+        const std::vector<std::vector<size_t>> &triangles,
+        const std::vector<Hu::Vector3> &triangleNormals,
+        double thresholdAngle,
+        std::vector<Hu::Vector3> &triangleVertexNormals,
+        size_t maxThreads=0)
+    {
+        CornerAdjacency adjacency;
+        std::vector<Hu::Vector3> angleAreaWeightedNormals;
+        std::vector<Hu::Vector3> unitTriangleNormals;
+        buildCornerAdjacency(vertices.size(), triangles, &adjacency);
+        angleAreaWeightedNormals.resize(adjacency.cornerTriangles.size());
+        unitTriangleNormals.resize(triangles.size());
+        size_t triangleBlockCount = (triangles.size() + m_parallelBlockSize - 1) / m_parallelBlockSize;
+        Hu::parallelFor(triangleBlockCount, [&](size_t block) {
+            size_t begin = block * m_parallelBlockSize;
+            weightCornerNormals(begin, std::min(begin + m_parallelBlockSize, triangles.size()), vertices, triangles, triangleNormals, 
+                adjacency, angleAreaWeightedNormals, unitTriangleNormals);
+        }, maxThreads);
+        triangleVertexNormals.resize(angleAreaWeightedNormals.size());
+        double minDot = minDotProduct(thresholdAngle);
+        size_t vertexBlockCount = (vertices.size() + m_parallelBlockSize - 1) / m_parallelBlockSize;
+        Hu::parallelFor(vertexBlockCount, [&](size_t block) {
+            size_t begin = block * m_parallelBlockSize;
+            smoothVertexNormals(begin, std::min(begin + m_parallelBlockSize, vertices.size()), adjacency, 
+                angleAreaWeightedNormals, unitTriangleNormals, minDot, triangleVertexNormals);
+        }, maxThreads);
+    }
+    
+private:
+    static const size_t m_parallelBlockSize = 4096;
+    
+    // Faces further apart than thresholdAngle are exactly the ones whose unit normals have a dot product 
+    // below its cosine, so no acos is needed per face pair
+    static double minDotProduct(double thresholdAngle)
+    {
+        if (thresholdAngle < 0)
+            return 2.0;
+        if (thresholdAngle >= Hu::Math::Pi)
+            return -2.0;
+        return std::cos(thresholdAngle);
+    }
+    
+    static double angleBetweenUnits(const Hu::Vector3 &a, const Hu::Vector3 &b)
+    {
+        double dot = Hu::Vector3::dotProduct(a, b);
+        if (dot <= -1.0)
+            return Hu::Math::Pi;
+        else if (dot >= 1.0)
+            return 0;
+        else
+            return std::acos(dot);
+    }
+    
+    static void weightCornerNormals(size_t triangleBegin, size_t triangleEnd,
+        const std::vector<Hu::Vector3> &vertices,
+        const std::vector<std::vector<size_t>> &triangles,
+        const std::vector<Hu::Vector3> &triangleNormals,
+        const CornerAdjacency &adjacency,
+        std::vector<Hu::Vector3> &angleAreaWeightedNormals,
+        std::vector<Hu::Vector3> &unitTriangleNormals)
+    {
+        for (size_t triangleIndex = triangleBegin; triangleIndex < triangleEnd; ++triangleIndex) {
+            const auto &sourceTriangle = triangles[triangleIndex];
+            if (sourceTriangle.size() != 3)
+                continue;
+            unitTriangleNormals[triangleIndex] = triangleNormals[triangleIndex].normalized();
             const auto &v1 = vertices[sourceTriangle[0]];
             const auto &v2 = vertices[sourceTriangle[1]];
             const auto &v3 = vertices[sourceTriangle[2]];
-            double area = Vector3::area(v1, v2, v3);
-            double angles[] = {Vector3::angle(v2-v1, v3-v1),
-                Vector3::angle(v1-v2, v3-v2),
-                Vector3::angle(v1-v3, v2-v3)};
+            double area = Hu::Vector3::area(v1, v2, v3);
+            Hu::Vector3 edges[] = {(v2 - v1).normalized(), (v3 - v2).normalized(), (v1 - v3).normalized()};
+            double angles[] = {angleBetweenUnits(edges[0], -edges[2]),
+                angleBetweenUnits(-edges[0], edges[1]),
+                angleBetweenUnits(edges[2], -edges[1])};
+            size_t corner = adjacency.triangleCornerBegins[triangleIndex];
             for (int i = 0; i < 3; ++i) {
                 if (sourceTriangle[i] >= vertices.size())
                     continue;
-                triangleVertexNormalsMapByIndices[sourceTriangle[i]].push_back({triangleIndex, angleAreaWeightedNormals.size()});
-                angleAreaWeightedNormals.push_back(triangleNormals[triangleIndex] * area * angles[i]);
+                angleAreaWeightedNormals[corner++] = triangleNormals[triangleIndex] * area * angles[i];
             }
         }
-        triangleVertexNormals = angleAreaWeightedNormals;
-        std::map<std::pair<size_t, size_t>, double> degreesBetweenFacesMap;
-        for (size_t vertexIndex = 0; vertexIndex < vertices.size(); ++vertexIndex) {
-            const auto &triangleVertices = triangleVertexNormalsMapByIndices[vertexIndex];
-            for (const auto &triangleVertex: triangleVertices) {
-                for (const auto &otherTriangleVertex: triangleVertices) {
-                    if (triangleVertex.first == otherTriangleVertex.first)
+    }
+    
+    // Each corner belongs to exactly one vertex, so disjoint vertex ranges write disjoint corners. 
+    // The faces around a vertex are gathered first and each face pair is tested once
+    static void smoothVertexNormals(size_t vertexBegin, size_t vertexEnd,
+        const CornerAdjacency &adjacency,
+        const std::vector<Hu::Vector3> &angleAreaWeightedNormals,
+        const std::vector<Hu::Vector3> &unitTriangleNormals,
+        double minDot,
+        std::vector<Hu::Vector3> &triangleVertexNormals)
+    {
+        std::vector<size_t> triangleIndices;
+        std::vector<Hu::Vector3> normals;
+        std::vector<Hu::Vector3> sums;
+        for (size_t vertexIndex = vertexBegin; vertexIndex < vertexEnd; ++vertexIndex) {
+            size_t cornerBegin = adjacency.vertexCornerBegins[vertexIndex];
+            size_t cornerCount = adjacency.vertexCornerBegins[vertexIndex + 1] - cornerBegin;
+            const size_t *corners = adjacency.vertexCorners.data() + cornerBegin;
+            triangleIndices.resize(cornerCount);
+            normals.resize(cornerCount);
+            sums.resize(cornerCount);
+            for (size_t i = 0; i < cornerCount; ++i) {
+                triangleIndices[i] = adjacency.cornerTriangles[corners[i]];
+                normals[i] = angleAreaWeightedNormals[corners[i]];
+                sums[i] = normals[i];
+            }
+            for (size_t i = 0; i < cornerCount; ++i) {
+                const auto &triangleNormal = unitTriangleNormals[triangleIndices[i]];
+                for (size_t j = i + 1; j < cornerCount; ++j) {
+                    if (triangleIndices[j] == triangleIndices[i])
                         continue;
-                    double angle = 0;
-                    auto findDegreesResult = degreesBetweenFacesMap.find({triangleVertex.first, otherTriangleVertex.first});
-                    if (findDegreesResult == degreesBetweenFacesMap.end()) {
-                        angle = Vector3::angle(triangleNormals[triangleVertex.first], triangleNormals[otherTriangleVertex.first]);
-                        degreesBetweenFacesMap.insert({{triangleVertex.first, otherTriangleVertex.first}, angle});
-                        degreesBetweenFacesMap.insert({{otherTriangleVertex.first, triangleVertex.first}, angle});
-                    } else {
-                        angle = findDegreesResult->second;
-                    }
-                    if (angle > thresholdAngle)
+                    if (Hu::Vector3::dotProduct(triangleNormal, unitTriangleNormals[triangleIndices[j]]) < minDot)
                         continue;
-                    triangleVertexNormals[triangleVertex.second] += angleAreaWeightedNormals[otherTriangleVertex.second];
+                    sums[i] += normals[j];
+                    sums[j] += normals[i];
                 }
             }
+            for (size_t i = 0; i < cornerCount; ++i)
+                triangleVertexNormals[corners[i]] = sums[i].normalized();
         }
-        for (auto &item: triangleVertexNormals)
-            item.normalize();
     }
-
 };
  
 }
 
 #endif
-
@@ -23,11 +23,19 @@
 #ifndef DUST3D_MESH_TUBE_MESH_BUILDER_H_
 #define DUST3D_MESH_TUBE_MESH_BUILDER_H_
 
+#include <cstdint>
 #include <memory>
 #include <algorithm>
 #include <set>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
 #include <hu/base/debug.h>
+#include <hu/base/math.h>
+#include <hu/base/parallel_for.h>
 #include <hu/base/vector2.h>
+#include <hu/base/vector3.h>
 
 namespace Dust3d
 {
@@ -61,166 +69,595 @@ public:
         m_sectionFillPattern = pattern;
     }
     
+    // Zero keeps every section and polygon point. Otherwise build() first drops polygon points and whole 
+    // sections as long as the mesh stays within this distance of the full resolution one. For a screen space 
+    // bound pass pixels * distance / focal length
+    void setResampleTolerance(double tolerance)
+    {
+        m_resampleTolerance = tolerance;
+    }
+    
+    // Output is kept flat: vertices of all sections back to back, 4 indices per quad, 
+    // and profile edges as a sorted array without duplicates
     bool build()
     {
         if (nullptr == m_sections)
             return false;
         
-        std::vector<std::vector<Hu::Vector3>> sectionPolygons(m_sections->size());
+        if (m_resampleTolerance > 0.0 && !m_sections->empty()) {
+            if (!resampleSections(*m_sections, &m_resampledSections))
+                return false;
+        }
+        const auto &sections = m_resampleTolerance > 0.0 ? m_resampledSections : *m_sections;
+        if (sections.empty())
+            return false;
+        
+        auto &sectionOffsets = m_sectionOffsets;
+        sectionOffsets.resize(sections.size() + 1);
+        sectionOffsets[0] = 0;
+        for (size_t i = 0; i < sections.size(); ++i)
+            sectionOffsets[i + 1] = sectionOffsets[i] + (std::uint32_t)sections[i].polygon.size();
         
-        for (size_t i = 0; i < m_sections->size(); ++i) {
-            if (!makeSectionPolygon(m_sections->at(i), sectionPolygons[i])) {
-                huDebug << "Make section polygon failed on:[" << i << "/" << m_sections->size() << "].";
+        m_builtProfilePointOffsets.resize(sections.size() + 1);
+        m_builtProfilePointOffsets[0] = 0;
+        m_builtProfilePoints.clear();
+        for (size_t i = 0; i < sections.size(); ++i) {
+            m_builtProfilePoints.insert(m_builtProfilePoints.end(), sections[i].profilePoints.begin(), sections[i].profilePoints.end());
+            m_builtProfilePointOffsets[i + 1] = m_builtProfilePoints.size();
+        }
+        
+        m_meshVertices = std::make_unique<std::vector<Hu::Vector3>>(sectionOffsets.back());
+        for (size_t i = 0; i < sections.size(); ++i) {
+            if (!makeSectionPolygon(sections[i], m_meshVertices->data() + sectionOffsets[i])) {
+                huDebug << "Make section polygon failed on:[" << i << "/" << sections.size() << "].";
                 return false;
             }
         }
         
-        std::vector<std::vector<size_t>> meshVertexIndices(sectionPolygons.size());
-        m_meshVertices = std::make_unique<std::vector<Hu::Vector3>>();
-        for (size_t i = 0; i < sectionPolygons.size(); ++i) {
-            meshVertexIndices[i].resize(sectionPolygons[i].size());
-            for (size_t j = 0; j < sectionPolygons[i].size(); ++j) {
-                meshVertexIndices[i][j] = m_meshVertices->size();
-                m_meshVertices->push_back(sectionPolygons[i][j]);
-            }
+        size_t profileEdgeCount = sections.front().polygon.size() + sections.back().polygon.size();
+        size_t quadCount = 0;
+        for (size_t i = 0; i + 1 < sections.size(); ++i) {
+            profileEdgeCount += sections[i].profilePoints.size();
+            quadCount += sections[i].polygon.size();
         }
+        quadCount += sections.front().polygon.size() / 2 + sections.back().polygon.size() / 2;
         
-        m_meshProfileEdges = std::make_unique<std::set<std::pair<size_t, size_t>>>();
+        m_meshProfileEdgeList = std::make_unique<std::vector<std::pair<std::uint32_t, std::uint32_t>>>();
+        m_meshProfileEdgeList->reserve(profileEdgeCount);
+        m_meshQuadIndices = std::make_unique<std::vector<std::uint32_t>>();
+        m_meshQuadIndices->reserve(quadCount * 4);
         
-        m_meshQuads = std::make_unique<std::vector<std::vector<size_t>>>();
-        for (size_t j = 1; j < sectionPolygons.size(); ++j) {
+        for (size_t j = 1; j < sections.size(); ++j) {
             size_t i = j - 1;
-            const auto &edgeLoopI = meshVertexIndices[i];
-            const auto &edgeLoopJ = meshVertexIndices[j];
-            if (edgeLoopI.size() != edgeLoopJ.size()) {
-                huDebug << "Edge loop have unmatched size [" << i << "]:" << edgeLoopI.size() << "[" << j << "]:" << edgeLoopJ.size() << ".";
+            std::uint32_t loopI = sectionOffsets[i];
+            std::uint32_t loopJ = sectionOffsets[j];
+            std::uint32_t loopSize = sectionOffsets[j] - sectionOffsets[i];
+            if (loopSize != sectionOffsets[j + 1] - sectionOffsets[j]) {
+                huDebug << "Edge loop have unmatched size [" << i << "]:" << loopSize << "[" << j << "]:" << (sectionOffsets[j + 1] - sectionOffsets[j]) << ".";
                 return false;
             }
-            for (const auto &it: m_sections->at(i).profilePoints)
-                m_meshProfileEdges->insert({edgeLoopI[it % edgeLoopI.size()], edgeLoopJ[it % edgeLoopJ.size()]});
-            for (size_t m = 0; m < edgeLoopI.size(); ++m) {
-                size_t n = (m + 1) % edgeLoopI.size();
-                m_meshQuads->push_back({
-                    edgeLoopI[m], 
-                    edgeLoopI[n],
-                    edgeLoopJ[n],
-                    edgeLoopJ[m]
+            for (const auto &it: sections[i].profilePoints)
+                m_meshProfileEdgeList->push_back({loopI + it % loopSize, loopJ + it % loopSize});
+            for (std::uint32_t m = 0; m < loopSize; ++m) {
+                std::uint32_t n = (m + 1) % loopSize;
+                m_meshQuadIndices->insert(m_meshQuadIndices->end(), {
+                    loopI + m, 
+                    loopI + n,
+                    loopJ + n,
+                    loopJ + m
                 });
             }
         }
         
-        if (meshVertexIndices.size() > 1) {
-            auto indices = meshVertexIndices.front();
-            std::reverse(indices.begin(), indices.end());
-            fillSection(indices);
-            for (size_t i = 0; i < meshVertexIndices.front().size(); ++i)
-                m_meshProfileEdges->insert({meshVertexIndices.front()[i], meshVertexIndices.front()[(i + 1) % meshVertexIndices.front().size()]});
+        if (sections.size() > 1) {
+            fillSection(sectionOffsets[0], sectionOffsets[1] - sectionOffsets[0], true);
+            addLoopEdges(sectionOffsets[0], sectionOffsets[1] - sectionOffsets[0]);
         }
-        fillSection(meshVertexIndices.back());
-        for (size_t i = 0; i < meshVertexIndices.back().size(); ++i)
-            m_meshProfileEdges->insert({meshVertexIndices.back()[i], meshVertexIndices.back()[(i + 1) % meshVertexIndices.back().size()]});
+        fillSection(sectionOffsets[sections.size() - 1], sectionOffsets[sections.size()] - sectionOffsets[sections.size() - 1], false);
+        addLoopEdges(sectionOffsets[sections.size() - 1], sectionOffsets[sections.size()] - sectionOffsets[sections.size() - 1]);
+        
+        std::sort(m_meshProfileEdgeList->begin(), m_meshProfileEdgeList->end());
+        m_meshProfileEdgeList->erase(std::unique(m_meshProfileEdgeList->begin(), m_meshProfileEdgeList->end()), m_meshProfileEdgeList->end());
         
         return true;
     }
     
+    // For sections [dirtyBegin, dirtyEnd) edited in place through sections(). As long as their ring sizes and
+    // profile points stay as built, quads and profile edges only refer to vertex indices which don't move, 
+    // so recomputing the dirty rings in the kept vertex buffer is all it takes. Anything else, or output 
+    // which has been taken away, falls back to a full build
+    bool rebuild(size_t dirtyBegin, size_t dirtyEnd)
+    {
+        if (!canRebuild(dirtyBegin, dirtyEnd))
+            return build();
+        const auto &sections = *m_sections;
+        for (size_t i = dirtyBegin; i < dirtyEnd; ++i) {
+            if (!makeSectionPolygon(sections[i], m_meshVertices->data() + m_sectionOffsets[i])) {
+                huDebug << "Make section polygon failed on:[" << i << "/" << sections.size() << "].";
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    std::vector<Section> *sections()
+    {
+        return m_sections.get();
+    }
+    
+    const std::vector<Hu::Vector3> *meshVertices() const
+    {
+        return m_meshVertices.get();
+    }
+    
+    const std::vector<std::uint32_t> *meshQuadIndices() const
+    {
+        return m_meshQuadIndices.get();
+    }
+    
+    const std::vector<std::pair<std::uint32_t, std::uint32_t>> *meshProfileEdgeList() const
+    {
+        return m_meshProfileEdgeList.get();
+    }
+    
     std::unique_ptr<std::vector<Hu::Vector3>> takeMeshVertices()
     {
         return std::move(m_meshVertices);
     }
     
+    // 4 indices per quad
+    std::unique_ptr<std::vector<std::uint32_t>> takeMeshQuadIndices()
+    {
+        return std::move(m_meshQuadIndices);
+    }
+    
+    // Sorted, without duplicates
+    std::unique_ptr<std::vector<std::pair<std::uint32_t, std::uint32_t>>> takeMeshProfileEdgeList()
+    {
+        return std::move(m_meshProfileEdgeList);
+    }
+    
+    // 3 indices per triangle, two triangles per quad
+    void getMeshTriangleIndices(std::vector<std::uint32_t> &triangleIndices)
+    {
+        if (nullptr == m_meshQuadIndices)
+            return;
+        const auto &quadIndices = *m_meshQuadIndices;
+        triangleIndices.resize(quadIndices.size() / 4 * 6);
+        for (size_t i = 0, targetIndex = 0; i + 3 < quadIndices.size(); i += 4) {
+            triangleIndices[targetIndex++] = quadIndices[i];
+            triangleIndices[targetIndex++] = quadIndices[i + 1];
+            triangleIndices[targetIndex++] = quadIndices[i + 2];
+            triangleIndices[targetIndex++] = quadIndices[i + 2];
+            triangleIndices[targetIndex++] = quadIndices[i + 3];
+            triangleIndices[targetIndex++] = quadIndices[i];
+        }
+    }
+    
     std::unique_ptr<std::vector<std::vector<size_t>>> takeMeshQuads()
     {
-        return std::move(m_meshQuads);
+        if (nullptr == m_meshQuadIndices)
+            return nullptr;
+        auto quads = std::make_unique<std::vector<std::vector<size_t>>>(m_meshQuadIndices->size() / 4);
+        for (size_t i = 0; i < quads->size(); ++i) {
+            const std::uint32_t *quad = m_meshQuadIndices->data() + i * 4;
+            (*quads)[i] = std::vector<size_t> {quad[0], quad[1], quad[2], quad[3]};
+        }
+        m_meshQuadIndices.reset();
+        return quads;
     }
     
     std::unique_ptr<std::set<std::pair<size_t, size_t>>> takeMeshProfileEdges()
     {
-        return std::move(m_meshProfileEdges);
+        if (nullptr == m_meshProfileEdgeList)
+            return nullptr;
+        auto edges = std::make_unique<std::set<std::pair<size_t, size_t>>>(m_meshProfileEdgeList->begin(), m_meshProfileEdgeList->end());
+        m_meshProfileEdgeList.reset();
+        return edges;
     }
     
     void getMeshTriangles(std::vector<std::vector<size_t>> &triangles)
     {
-        if (nullptr == m_meshQuads)
+        if (nullptr == m_meshQuadIndices)
             return;
-        triangles.resize(m_meshQuads->size() * 2);
-        for (size_t i = 0, targetIndex = 0; i < m_meshQuads->size(); ++i) {
-            const auto &quad = m_meshQuads->at(i);
-            triangles[targetIndex++] = std::vector<size_t> {quad[0], quad[1], quad[2]};
-            triangles[targetIndex++] = std::vector<size_t> {quad[2], quad[3], quad[0]};
+        const auto &quadIndices = *m_meshQuadIndices;
+        triangles.resize(quadIndices.size() / 4 * 2);
+        for (size_t i = 0, targetIndex = 0; i + 3 < quadIndices.size(); i += 4) {
+            triangles[targetIndex++] = std::vector<size_t> {quadIndices[i], quadIndices[i + 1], quadIndices[i + 2]};
+            triangles[targetIndex++] = std::vector<size_t> {quadIndices[i + 2], quadIndices[i + 3], quadIndices[i]};
         }
     }
     
+    // Many tubes merged into shared buffers, tube i owns vertices [vertexOffsets[i], vertexOffsets[i + 1]) 
+    // and quad indices [quadIndexOffsets[i], quadIndexOffsets[i + 1])
+    struct MeshBatch
+    {
+        std::vector<Hu::Vector3> vertices;
+        std::vector<std::uint32_t> quadIndices;
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> profileEdges;
+        std::vector<std::uint32_t> vertexOffsets;
+        std::vector<std::uint32_t> quadIndexOffsets;
+    };
+    
+    // Build each tube on its own thread, then merge in input order so offsets don't depend on scheduling.
+    // A tube which failed to build is left empty and makes the result false, the others are still merged
+    static bool buildBatch(std::vector<std::unique_ptr<std::vector<Section>>> sectionsList, MeshBatch *batch,
+        SectionFillPattern sectionFillPattern=SectionFillPattern::Strips, size_t maxThreads=0)
+    {
+        size_t tubeCount = sectionsList.size();
+        std::vector<std::unique_ptr<TubeMeshBuilder>> builders(tubeCount);
+        std::vector<size_t> buildOrder(tubeCount);
+        for (size_t i = 0; i < tubeCount; ++i) {
+            buildOrder[i] = i;
+            builders[i] = std::make_unique<TubeMeshBuilder>(std::move(sectionsList[i]));
+            builders[i]->setSectionFillPattern(sectionFillPattern);
+        }
+        
+        // Longest tubes first, so a big one picked up late doesn't leave the other threads idle
+        std::sort(buildOrder.begin(), buildOrder.end(), [&](size_t first, size_t second) {
+            return builders[first]->sectionCount() > builders[second]->sectionCount();
+        });
+        std::vector<char> built(tubeCount, 0);
+        Hu::parallelFor(tubeCount, [&](size_t index) {
+            size_t tubeIndex = buildOrder[index];
+            built[tubeIndex] = builders[tubeIndex]->build() ? 1 : 0;
+        }, maxThreads);
+        
+        batch->vertexOffsets.assign(tubeCount + 1, 0);
+        batch->quadIndexOffsets.assign(tubeCount + 1, 0);
+        std::vector<size_t> profileEdgeOffsets(tubeCount + 1, 0);
+        for (size_t i = 0; i < tubeCount; ++i) {
+            const auto &builder = *builders[i];
+            bool isBuilt = 0 != built[i];
+            batch->vertexOffsets[i + 1] = batch->vertexOffsets[i] + (isBuilt ? (std::uint32_t)builder.m_meshVertices->size() : 0);
+            batch->quadIndexOffsets[i + 1] = batch->quadIndexOffsets[i] + (isBuilt ? (std::uint32_t)builder.m_meshQuadIndices->size() : 0);
+            profileEdgeOffsets[i + 1] = profileEdgeOffsets[i] + (isBuilt ? builder.m_meshProfileEdgeList->size() : 0);
+        }
+        batch->vertices.resize(batch->vertexOffsets.back());
+        batch->quadIndices.resize(batch->quadIndexOffsets.back());
+        batch->profileEdges.resize(profileEdgeOffsets.back());
+        
+        // Each tube's edges are sorted and offsets only grow, so the merged edge list stays sorted
+        Hu::parallelFor(tubeCount, [&](size_t i) {
+            if (0 == built[i])
+                return;
+            const auto &builder = *builders[i];
+            std::uint32_t vertexOffset = batch->vertexOffsets[i];
+            std::copy(builder.m_meshVertices->begin(), builder.m_meshVertices->end(), batch->vertices.begin() + vertexOffset);
+            std::transform(builder.m_meshQuadIndices->begin(), builder.m_meshQuadIndices->end(), batch->quadIndices.begin() + batch->quadIndexOffsets[i], 
+                [=](std::uint32_t index) {
+                    return index + vertexOffset;
+                });
+            std::transform(builder.m_meshProfileEdgeList->begin(), builder.m_meshProfileEdgeList->end(), batch->profileEdges.begin() + profileEdgeOffsets[i], 
+                [=](const std::pair<std::uint32_t, std::uint32_t> &edge) {
+                    return std::make_pair(edge.first + vertexOffset, edge.second + vertexOffset);
+                });
+        }, maxThreads);
+        
+        return std::all_of(built.begin(), built.end(), [](char isBuilt) {
+            return 0 != isBuilt;
+        });
+    }
+    
+    size_t sectionCount() const
+    {
+        return nullptr == m_sections ? 0 : m_sections->size();
+    }
+    
 private:
     SectionFillPattern m_sectionFillPattern = SectionFillPattern::Strips;
     std::unique_ptr<std::vector<Section>> m_sections;
     std::unique_ptr<std::vector<Hu::Vector3>> m_meshVertices;
-    std::unique_ptr<std::vector<std::vector<size_t>>> m_meshQuads;
-    std::unique_ptr<std::set<std::pair<size_t, size_t>>> m_meshProfileEdges;
+    std::unique_ptr<std::vector<std::uint32_t>> m_meshQuadIndices;
+    std::unique_ptr<std::vector<std::pair<std::uint32_t, std::uint32_t>>> m_meshProfileEdgeList;
     
-    bool fillSection(const std::vector<size_t> &polygon)
+    // Per point coefficients of a 2D polygon, reused while consecutive sections share the same polygon
+    struct SectionProfile
     {
+        std::vector<Hu::Vector2> polygon;
+        std::vector<double> up;
+        std::vector<double> side;
+        std::vector<double> axial;
+        bool isValid = false;
+    };
+    SectionProfile m_sectionProfile;
+    
+    double m_resampleTolerance = 0.0;
+    std::vector<Section> m_resampledSections;
+    static const size_t m_maxResampleSpan = 64;
+    std::vector<std::uint32_t> m_sectionOffsets;
+    std::vector<int> m_builtProfilePoints;
+    std::vector<size_t> m_builtProfilePointOffsets;
+    
+    bool canRebuild(size_t dirtyBegin, size_t dirtyEnd) const
+    {
+        if (nullptr == m_sections || nullptr == m_meshVertices || nullptr == m_meshQuadIndices || nullptr == m_meshProfileEdgeList)
+            return false;
+        if (m_resampleTolerance > 0.0)
+            return false;
+        const auto &sections = *m_sections;
+        if (sections.size() + 1 != m_sectionOffsets.size() || dirtyBegin > dirtyEnd || dirtyEnd > sections.size())
+            return false;
+        for (size_t i = dirtyBegin; i < dirtyEnd; ++i) {
+            if (sections[i].polygon.size() != m_sectionOffsets[i + 1] - m_sectionOffsets[i])
+                return false;
+            const auto &profilePoints = sections[i].profilePoints;
+            if (profilePoints.size() != m_builtProfilePointOffsets[i + 1] - m_builtProfilePointOffsets[i] ||
+                    !std::equal(profilePoints.begin(), profilePoints.end(), m_builtProfilePoints.begin() + m_builtProfilePointOffsets[i]))
+                return false;
+        }
+        return true;
+    }
+    
+    void addLoopEdges(std::uint32_t offset, std::uint32_t size)
+    {
+        for (std::uint32_t i = 0; i < size; ++i)
+            m_meshProfileEdgeList->push_back({offset + i, offset + (i + 1) % size});
+    }
+    
+    // Vertices of the section are offset .. offset + size - 1, reversed when filling the front cap
+    bool fillSection(std::uint32_t offset, std::uint32_t size, bool reversed)
+    {
+        auto polygon = [=](size_t i) -> std::uint32_t {
+            return reversed ? offset + size - 1 - (std::uint32_t)i : offset + (std::uint32_t)i;
+        };
         switch (m_sectionFillPattern) {
             case SectionFillPattern::Strips: {
-                    if (0 != polygon.size() % 2) {
-                        huDebug << "Polygon could not be fill strips with odd size:" << polygon.size();
+                    if (0 != size % 2) {
+                        huDebug << "Polygon could not be fill strips with odd size:" << size;
                         return false;
                     }
-                    size_t halfSize = polygon.size() / 2;
+                    size_t halfSize = size / 2;
                     size_t quartSize = halfSize / 2;
                     // FIXME: Not sure if it will work on both odd/even case
                     for (size_t i = 0; i < quartSize; i += 2) {
-                        m_meshQuads->push_back({
-                            polygon[i],
-                            polygon[i + 1],
-                            polygon[(i + halfSize - 1) % polygon.size()],
-                            polygon[(i + halfSize) % polygon.size()]
+                        m_meshQuadIndices->insert(m_meshQuadIndices->end(), {
+                            polygon(i),
+                            polygon(i + 1),
+                            polygon((i + halfSize - 1) % size),
+                            polygon((i + halfSize) % size)
                         });
                     }
                     for (size_t i = halfSize; i < halfSize + quartSize; i += 2) {
-                        m_meshQuads->push_back({
-                            polygon[i],
-                            polygon[i + 1],
-                            polygon[(i + halfSize - 1) % polygon.size()],
-                            polygon[(i + halfSize) % polygon.size()]
+                        m_meshQuadIndices->insert(m_meshQuadIndices->end(), {
+                            polygon(i),
+                            polygon(i + 1),
+                            polygon((i + halfSize - 1) % size),
+                            polygon((i + halfSize) % size)
                         });
                     }
                 } break;
+            default:
+                break;
         }
         return true;
     }
 
-    bool makeSectionPolygon(const Section &section, std::vector<Hu::Vector3> &polygon3d)
+    static double distanceToSegment(const Hu::Vector2 &point, const Hu::Vector2 &begin, const Hu::Vector2 &end)
+    {
+        Hu::Vector2 direction = end - begin;
+        double lengthSquared = direction.lengthSquared();
+        double t = Hu::Math::isZero(lengthSquared) ? 0.0 : 
+            std::clamp(Hu::Vector2::dotProduct(point - begin, direction) / lengthSquared, 0.0, 1.0);
+        return (point - (begin + direction * t)).length();
+    }
+    
+    static double maxPolygonRadius(const std::vector<Hu::Vector2> &polygon, size_t step)
+    {
+        double maxRadius = 0.0;
+        for (size_t i = 0; i < polygon.size(); i += step)
+            maxRadius = std::max(maxRadius, polygon[i].length());
+        return maxRadius;
+    }
+    
+    // Largest step for keeping every step-th polygon point. The remaining ring has to stay even for strip 
+    // filling, keep all profile points and the max radius, and no dropped point may be further than tolerance 
+    // from the edge replacing it, measured at the section's own scale
+    size_t polygonStep(const std::vector<Section> &sections) const
+    {
+        size_t pointCount = sections.front().polygon.size();
+        for (const auto &section: sections) {
+            if (section.polygon.size() != pointCount)
+                return 1;
+        }
+        for (size_t step = pointCount / 4; step > 1; --step) {
+            if (0 != pointCount % step || 0 != (pointCount / step) % 2)
+                continue;
+            bool isValid = true;
+            for (size_t s = 0; s < sections.size() && isValid; ++s) {
+                const auto &section = sections[s];
+                for (const auto &it: section.profilePoints) {
+                    if (0 != (it % pointCount) % step) {
+                        isValid = false;
+                        break;
+                    }
+                }
+                double maxRadius = maxPolygonRadius(section.polygon, 1);
+                if (!isValid || Hu::Math::isZero(maxRadius) || !Hu::Math::isEqual(maxRadius, maxPolygonRadius(section.polygon, step))) {
+                    isValid = false;
+                    break;
+                }
+                double scale = section.radius / maxRadius;
+                for (size_t i = 0; i < pointCount && isValid; i += step) {
+                    const auto &begin = section.polygon[i];
+                    const auto &end = section.polygon[(i + step) % pointCount];
+                    for (size_t j = i + 1; j < i + step; ++j) {
+                        if (distanceToSegment(section.polygon[j], begin, end) * scale > m_resampleTolerance) {
+                            isValid = false;
+                            break;
+                        }
+                    }
+                }
+            }
+            if (isValid)
+                return step;
+        }
+        return 1;
+    }
+    
+    // Reduce the polygon resolution first, then walk along the tube and drop each section whose ring lies 
+    // within tolerance of the ring interpolated between the neighbours kept around it. Curvature, twist and 
+    // radius change all show up as distance from that interpolation
+    bool resampleSections(const std::vector<Section> &sections, std::vector<Section> *resampledSections)
+    {
+        size_t step = polygonStep(sections);
+        std::vector<Section> reducedSections;
+        const std::vector<Section> *sourceSections = &sections;
+        if (step > 1) {
+            size_t pointCount = sections.front().polygon.size();
+            reducedSections.resize(sections.size());
+            for (size_t s = 0; s < sections.size(); ++s) {
+                const auto &section = sections[s];
+                auto &reducedSection = reducedSections[s];
+                reducedSection.origin = section.origin;
+                reducedSection.radius = section.radius;
+                reducedSection.normal = section.normal;
+                reducedSection.bitangent = section.bitangent;
+                reducedSection.polygon.reserve(pointCount / step);
+                for (size_t i = 0; i < pointCount; i += step)
+                    reducedSection.polygon.push_back(section.polygon[i]);
+                reducedSection.profilePoints.reserve(section.profilePoints.size());
+                for (const auto &it: section.profilePoints)
+                    reducedSection.profilePoints.push_back((int)((it % pointCount) / step));
+            }
+            sourceSections = &reducedSections;
+        }
+        const auto &source = *sourceSections;
+        
+        std::vector<size_t> ringOffsets(source.size() + 1, 0);
+        for (size_t s = 0; s < source.size(); ++s)
+            ringOffsets[s + 1] = ringOffsets[s] + source[s].polygon.size();
+        std::vector<Hu::Vector3> rings(ringOffsets.back());
+        std::vector<double> distances(source.size(), 0.0);
+        for (size_t s = 0; s < source.size(); ++s) {
+            if (!makeSectionPolygon(source[s], rings.data() + ringOffsets[s]))
+                return false;
+            if (s > 0)
+                distances[s] = distances[s - 1] + (source[s].origin - source[s - 1].origin).length();
+        }
+        
+        auto isRemovable = [&](size_t first, size_t middle, size_t last) {
+            size_t pointCount = source[middle].polygon.size();
+            if (source[first].polygon.size() != pointCount || source[last].polygon.size() != pointCount)
+                return false;
+            double span = distances[last] - distances[first];
+            double t = Hu::Math::isZero(span) ? 
+                (double)(middle - first) / (last - first) : 
+                (distances[middle] - distances[first]) / span;
+            for (size_t i = 0; i < pointCount; ++i) {
+                const auto &from = rings[ringOffsets[first] + i];
+                const auto &to = rings[ringOffsets[last] + i];
+                Hu::Vector3 interpolated = from + (to - from) * t;
+                if ((rings[ringOffsets[middle] + i] - interpolated).length() > m_resampleTolerance)
+                    return false;
+            }
+            return true;
+        };
+        
+        std::vector<size_t> keptSections;
+        keptSections.push_back(0);
+        size_t first = 0;
+        while (first + 1 < source.size()) {
+            size_t last = first + 1;
+            while (last + 1 < source.size() && last + 1 - first <= m_maxResampleSpan) {
+                size_t candidate = last + 1;
+                bool canExtend = true;
+                for (size_t middle = first + 1; middle < candidate; ++middle) {
+                    if (!isRemovable(first, middle, candidate)) {
+                        canExtend = false;
+                        break;
+                    }
+                }
+                if (!canExtend)
+                    break;
+                last = candidate;
+            }
+            keptSections.push_back(last);
+            first = last;
+        }
+        
+        resampledSections->resize(keptSections.size());
+        for (size_t k = 0; k < keptSections.size(); ++k)
+            (*resampledSections)[k] = source[keptSections[k]];
+        return true;
+    }
+    
+    bool updateSectionProfile(const std::vector<Hu::Vector2> &polygon)
+    {
+        auto &profile = m_sectionProfile;
+        if (profile.polygon.size() == polygon.size() && 
+                std::equal(polygon.begin(), polygon.end(), profile.polygon.begin(), [](const Hu::Vector2 &first, const Hu::Vector2 &second) {
+                    return first.x() == second.x() && first.y() == second.y();
+                })) {
+            return profile.isValid;
+        }
+        
+        profile.polygon = polygon;
+        profile.up.resize(polygon.size());
+        profile.side.resize(polygon.size());
+        profile.axial.resize(polygon.size());
+        double maxRadius = 0.0;
+        for (size_t i = 0; i < polygon.size(); ++i) {
+            profile.axial[i] = polygon[i].length();
+            maxRadius = std::max(maxRadius, profile.axial[i]);
+        }
+        profile.isValid = !Hu::Math::isZero(maxRadius);
+        if (!profile.isValid)
+            return false;
+        for (size_t i = 0; i < polygon.size(); ++i) {
+            profile.up[i] = polygon[i].y() / maxRadius;
+            profile.side[i] = -polygon[i].x() / maxRadius;
+            profile.axial[i] = (profile.axial[i] - polygon[i].y()) / maxRadius;
+        }
+        return true;
+    }
+    
+    // Each point used to be the bitangent rotated around the normal by the point's angle from up, scaled by its radius.
+    // With cos = y / length and sin = -x / length that rotation is linear in the 2D point, so once the frame is known
+    // a point is origin + bitangent * up + (normal x bitangent) * side + normal * (normal . bitangent) * axial
+    bool makeSectionPolygon(const Section &section, Hu::Vector3 *polygon3d)
     {
         if (section.polygon.size() <= 2) {
             huDebug << "Polygon requires three points at least, current points:" << section.polygon.size();
             return false;
         }
         
-        std::vector<double> radiusList(section.polygon.size());
-        for (size_t i = 0; i < section.polygon.size(); ++i)
-            radiusList[i] = section.polygon[i].length();
-        double maxRadius = *std::max_element(radiusList.begin(), radiusList.end(), [](const auto &first, const auto &second) {
-            return first < second;
-        });
-        if (Math::isZero(maxRadius)) {
+        if (!updateSectionProfile(section.polygon)) {
             huDebug << "Polygon max radius is zero";
             return false;
         }
-        for (auto &it: radiusList)
-            it /= maxRadius;
-        
-        polygon3d.resize(section.polygon.size());
-        for (size_t i = 0; i < section.polygon.size(); ++i) {
-            double angle2d = Hu::Vector3::angle(
-                Hu::Vector3(0.0, 1.0, 0.0), // Up
-                Hu::Vector3(section.polygon[i]), 
-                Hu::Vector3(0.0, 0.0, 1.0) // Out
-            );
-            auto tangent = Hu::Vector3::crossProduct(section.bitangent, section.normal);
-            auto recalculatedBitangent = Hu::Vector3::crossProduct(section.normal, tangent).normalized();
-            polygon3d[i] = section.origin + 
-                recalculatedBitangent.rotated(section.normal, angle2d) * radiusList[i] * section.radius;
+        
+        auto tangent = Hu::Vector3::crossProduct(section.bitangent, section.normal);
+        auto recalculatedBitangent = Hu::Vector3::crossProduct(section.normal, tangent).normalized();
+        Hu::Vector3 upAxis = recalculatedBitangent * section.radius;
+        Hu::Vector3 sideAxis = Hu::Vector3::crossProduct(section.normal, recalculatedBitangent) * section.radius;
+        Hu::Vector3 axialAxis = section.normal * (Hu::Vector3::dotProduct(section.normal, recalculatedBitangent) * section.radius);
+        
+        const double *up = m_sectionProfile.up.data();
+        const double *side = m_sectionProfile.side.data();
+        const double *axial = m_sectionProfile.axial.data();
+        size_t count = section.polygon.size();
+        size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        __m128d originX = _mm_set1_pd(section.origin.x()), originY = _mm_set1_pd(section.origin.y()), originZ = _mm_set1_pd(section.origin.z());
+        __m128d upX = _mm_set1_pd(upAxis.x()), upY = _mm_set1_pd(upAxis.y()), upZ = _mm_set1_pd(upAxis.z());
+        __m128d sideX = _mm_set1_pd(sideAxis.x()), sideY = _mm_set1_pd(sideAxis.y()), sideZ = _mm_set1_pd(sideAxis.z());
+        __m128d axialX = _mm_set1_pd(axialAxis.x()), axialY = _mm_set1_pd(axialAxis.y()), axialZ = _mm_set1_pd(axialAxis.z());
+        for (; i + 1 < count; i += 2) {
+            __m128d u = _mm_loadu_pd(up + i);
+            __m128d v = _mm_loadu_pd(side + i);
+            __m128d w = _mm_loadu_pd(axial + i);
+            __m128d x = _mm_add_pd(_mm_add_pd(originX, _mm_mul_pd(upX, u)), _mm_add_pd(_mm_mul_pd(sideX, v), _mm_mul_pd(axialX, w)));
+            __m128d y = _mm_add_pd(_mm_add_pd(originY, _mm_mul_pd(upY, u)), _mm_add_pd(_mm_mul_pd(sideY, v), _mm_mul_pd(axialY, w)));
+            __m128d z = _mm_add_pd(_mm_add_pd(originZ, _mm_mul_pd(upZ, u)), _mm_add_pd(_mm_mul_pd(sideZ, v), _mm_mul_pd(axialZ, w)));
+            _mm_storeu_pd(&polygon3d[i].x(), _mm_unpacklo_pd(x, y));
+            _mm_store_sd(&polygon3d[i].z(), z);
+            _mm_storeu_pd(&polygon3d[i + 1].x(), _mm_unpackhi_pd(x, y));
+            _mm_storeh_pd(&polygon3d[i + 1].z(), z);
         }
+#endif
+        for (; i < count; ++i)
+            polygon3d[i] = section.origin + upAxis * up[i] + sideAxis * side[i] + axialAxis * axial[i];
         
         return true;
     }
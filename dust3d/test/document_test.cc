@@ -0,0 +1,101 @@
+/*
+ *  Copyright (c) 2016-2022 Jeremy HU <jeremy-at-dust3d dot org>. All rights reserved. 
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+// Standalone test for saving documents right after opening them, build and run with "nmake test".
+
+#include <filesystem>
+#include <iostream>
+#include <hu/base/image.h>
+#include <dust3d/document/document.h>
+#include <dust3d/document/ds3_file.h>
+
+static int failureCount = 0;
+
+static void check(bool condition, const char *what)
+{
+    if (condition)
+        return;
+    std::cerr << "FAILED: " << what << "\n";
+    ++failureCount;
+}
+
+// PNG decoders stop at IEND, the zeros after it only make sure deflate gains enough to keep the codec
+static std::string writeDeflatedReferenceImageFile(const std::string &path)
+{
+    Hu::Image image(64, 64);
+    image.clear(10, 20, 30, 255);
+    std::vector<std::uint8_t> pngBuffer;
+    image.saveAsPng(&pngBuffer);
+    pngBuffer.resize(pngBuffer.size() + 64 * 1024, 0);
+    Dust3d::Ds3FileWriter ds3Writer;
+    ds3Writer.add("canvas.png", "asset", std::move(pngBuffer), Dust3d::Ds3Codec::Deflate);
+    ds3Writer.save(path);
+    return path;
+}
+
+static bool hasReferenceImage(const std::string &path)
+{
+    Dust3d::Document document;
+    document.open(path);
+    const Hu::Image *image = document.referenceImage();
+    if (nullptr == image || 64 != image->width() || 64 != image->height())
+        return false;
+    const unsigned char *pixel = image->data();
+    return 10 == pixel[0] && 20 == pixel[1] && 30 == pixel[2] && 255 == pixel[3];
+}
+
+int main()
+{
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::string sourcePath = (directory / "document_test_source.ds3").string();
+    std::string otherPath = (directory / "document_test_other.ds3").string();
+    
+    writeDeflatedReferenceImageFile(sourcePath);
+    check(Dust3d::Ds3Codec::Deflate == Dust3d::Ds3FileReader(sourcePath).itemCodec("canvas.png"), "canvas.png is stored deflated");
+    
+    // Saved while the image is still pending and not decoding, it has to be decoded before the file is released
+    {
+        Dust3d::Document document;
+        document.open(sourcePath);
+        document.save(otherPath);
+    }
+    check(hasReferenceImage(otherPath), "save as after open keeps the deflated image");
+    
+    writeDeflatedReferenceImageFile(sourcePath);
+    {
+        Dust3d::Document document;
+        document.open(sourcePath);
+        document.save(sourcePath);
+        check(nullptr != document.referenceImage(), "image is still available after saving in place");
+    }
+    check(hasReferenceImage(sourcePath), "save in place after open keeps the deflated image");
+    
+    std::filesystem::remove(sourcePath);
+    std::filesystem::remove(otherPath);
+    
+    if (0 != failureCount) {
+        std::cerr << failureCount << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << "All checks passed\n";
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ *  Copyright (c) 2022 Jeremy HU <jeremy-at-dust3d dot org>. All rights reserved. 
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#ifndef HU_BASE_BOUNDING_BOX_H_
+#define HU_BASE_BOUNDING_BOX_H_
+
+#include <limits>
+#include <algorithm>
+#include <hu/base/vector3.h>
+#include <hu/base/matrix4x4.h>
+
+namespace Hu
+{
+
+class BoundingBox
+{
+public:
+    inline BoundingBox() :
+        m_lower(std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max()),
+        m_upper(std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest())
+    {
+    }
+
+    inline BoundingBox(const Vector3 &lower, const Vector3 &upper) :
+        m_lower(lower),
+        m_upper(upper)
+    {
+    }
+
+    inline const Vector3 &lower() const
+    {
+        return m_lower;
+    }
+
+    inline const Vector3 &upper() const
+    {
+        return m_upper;
+    }
+
+    inline bool isEmpty() const
+    {
+        return m_lower[0] > m_upper[0] || m_lower[1] > m_upper[1] || m_lower[2] > m_upper[2];
+    }
+
+    inline void add(double x, double y, double z)
+    {
+        m_lower[0] = std::min(m_lower[0], x);
+        m_lower[1] = std::min(m_lower[1], y);
+        m_lower[2] = std::min(m_lower[2], z);
+        m_upper[0] = std::max(m_upper[0], x);
+        m_upper[1] = std::max(m_upper[1], y);
+        m_upper[2] = std::max(m_upper[2], z);
+    }
+
+    inline void add(const Vector3 &position)
+    {
+        add(position[0], position[1], position[2]);
+    }
+
+    inline void unite(const BoundingBox &other)
+    {
+        if (other.isEmpty())
+            return;
+        add(other.m_lower);
+        add(other.m_upper);
+    }
+
+    inline Vector3 center() const
+    {
+        return (m_lower + m_upper) * 0.5;
+    }
+
+    inline Vector3 size() const
+    {
+        return m_upper - m_lower;
+    }
+
+    // Radius of the sphere through the corners, centered at center()
+    inline double radius() const
+    {
+        return size().length() * 0.5;
+    }
+
+    // Box around the eight transformed corners, so rotations may loosen it but never cut it
+    inline BoundingBox transformed(const Matrix4x4 &matrix) const
+    {
+        if (isEmpty())
+            return BoundingBox();
+        BoundingBox box;
+        for (size_t i = 0; i < 8; ++i) {
+            std::array<double, 4> corner = matrix * std::array<double, 4>({
+                (i & 1) ? m_upper[0] : m_lower[0],
+                (i & 2) ? m_upper[1] : m_lower[1],
+                (i & 4) ? m_upper[2] : m_lower[2],
+                1.0
+            });
+            box.add(corner[0], corner[1], corner[2]);
+        }
+        return box;
+    }
+
+private:
+    Vector3 m_lower;
+    Vector3 m_upper;
+};
+
+}
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ *  Copyright (c) 2022 Jeremy HU <jeremy-at-dust3d dot org>. All rights reserved. 
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#ifndef HU_BASE_BOUNDING_VOLUME_HIERARCHY_H_
+#define HU_BASE_BOUNDING_VOLUME_HIERARCHY_H_
+
+#include <vector>
+#include <algorithm>
+#include <hu/base/vector3.h>
+#include <hu/base/bounding_box.h>
+#include <hu/base/frustum.h>
+
+namespace Hu
+{
+
+class BoundingVolumeHierarchy
+{
+public:
+    inline void build(const std::vector<BoundingBox> &boxes)
+    {
+        m_boxes = boxes;
+        m_nodes.clear();
+        m_items.resize(boxes.size());
+        for (size_t i = 0; i < m_items.size(); ++i)
+            m_items[i] = i;
+        if (m_items.empty())
+            return;
+        m_nodes.reserve(m_items.size() * 2 / m_leafSize + 1);
+        buildNode(0, m_items.size());
+    }
+
+    inline void clear()
+    {
+        m_boxes.clear();
+        m_items.clear();
+        m_nodes.clear();
+    }
+
+    inline bool isEmpty() const
+    {
+        return m_nodes.empty();
+    }
+
+    // Call visit(itemIndex) for every box which is not entirely outside of the frustum,
+    // subtrees found entirely inside are reported without testing their items
+    template <class Visitor>
+    inline void query(const Frustum &frustum, Visitor visit) const
+    {
+        if (m_nodes.empty())
+            return;
+        size_t stack[64];
+        size_t stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0) {
+            const Node &node = m_nodes[stack[--stackSize]];
+            Frustum::Containment containment = frustum.classify(node.box);
+            if (Frustum::Containment::Outside == containment)
+                continue;
+            if (Frustum::Containment::Inside == containment) {
+                for (size_t i = node.begin; i < node.end; ++i)
+                    visit(m_items[i]);
+                continue;
+            }
+            if (0 == node.left) {
+                for (size_t i = node.begin; i < node.end; ++i) {
+                    if (frustum.intersects(m_boxes[m_items[i]]))
+                        visit(m_items[i]);
+                }
+                continue;
+            }
+            stack[stackSize++] = node.right;
+            stack[stackSize++] = node.left;
+        }
+    }
+
+private:
+    struct Node
+    {
+        BoundingBox box;
+        size_t begin;
+        size_t end;
+        size_t left;
+        size_t right;
+    };
+
+    std::vector<BoundingBox> m_boxes;
+    std::vector<size_t> m_items;
+    std::vector<Node> m_nodes;
+    size_t m_leafSize = 4;
+
+    // Split at the median item along the longest axis of the item centers, which keeps the depth
+    // at log2(count) so the fixed query stack can not overflow
+    inline size_t buildNode(size_t begin, size_t end)
+    {
+        size_t nodeIndex = m_nodes.size();
+        m_nodes.push_back(Node {BoundingBox(), begin, end, 0, 0});
+        BoundingBox box;
+        BoundingBox centers;
+        for (size_t i = begin; i < end; ++i) {
+            const BoundingBox &itemBox = m_boxes[m_items[i]];
+            box.unite(itemBox);
+            if (!itemBox.isEmpty())
+                centers.add(itemBox.center());
+        }
+        m_nodes[nodeIndex].box = box;
+        if (end - begin <= m_leafSize || centers.isEmpty())
+            return nodeIndex;
+        Vector3 extent = centers.size();
+        size_t axis = 0;
+        if (extent[1] > extent[axis])
+            axis = 1;
+        if (extent[2] > extent[axis])
+            axis = 2;
+        size_t middle = begin + (end - begin) / 2;
+        std::nth_element(m_items.begin() + begin, m_items.begin() + middle, m_items.begin() + end,
+                [&](size_t first, size_t second) {
+            return m_boxes[first].center()[axis] < m_boxes[second].center()[axis];
+        });
+        size_t left = buildNode(begin, middle);
+        size_t right = buildNode(middle, end);
+        m_nodes[nodeIndex].left = left;
+        m_nodes[nodeIndex].right = right;
+        return nodeIndex;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,77 @@
+/*
+ *  Copyright (c) 2022 Jeremy HU <jeremy-at-dust3d dot org>. All rights reserved. 
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include <climits>
+#include <cstdlib>
+#include <hu/base/debug.h>
+#include <hu/base/deflate.h>
+#include <third_party/stb/stb_image.h>
+
+// Implemented together with the PNG writer in image.cc, but not declared by stb_image_write.h
+extern "C" unsigned char *stbi_zlib_compress(unsigned char *data, int data_len, int *out_len, int quality);
+
+namespace Hu
+{
+namespace Deflate
+{
+
+bool compress(const std::uint8_t *data, size_t size, std::vector<std::uint8_t> *output, int quality)
+{
+    output->clear();
+    if (size > INT_MAX)
+        return false;
+    int outputSize = 0;
+    unsigned char *compressed = stbi_zlib_compress((unsigned char *)data, (int)size, &outputSize, quality);
+    if (nullptr == compressed) {
+        huDebug << "stbi_zlib_compress failed, size:" << size;
+        return false;
+    }
+    output->assign(compressed, compressed + outputSize);
+    free(compressed);
+    return true;
+}
+
+bool rawSizeIsPlausible(size_t size, size_t rawSize)
+{
+    return size <= INT_MAX && rawSize <= INT_MAX && rawSize / 1032 <= size;
+}
+
+// rawSize usually comes from a file header, so it is checked before anything gets allocated for it
+bool decompress(const std::uint8_t *data, size_t size, size_t rawSize, std::vector<std::uint8_t> *output)
+{
+    output->clear();
+    if (!rawSizeIsPlausible(size, rawSize)) {
+        huDebug << "Implausible deflate sizes, size:" << size << "rawSize:" << rawSize;
+        return false;
+    }
+    output->resize(rawSize);
+    int outputSize = stbi_zlib_decode_buffer((char *)output->data(), (int)rawSize, (const char *)data, (int)size);
+    if (outputSize != (int)rawSize) {
+        huDebug << "stbi_zlib_decode_buffer failed, expected:" << rawSize << "got:" << outputSize;
+        output->clear();
+        return false;
+    }
+    return true;
+}
+
+}
+}
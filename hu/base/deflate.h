@@ -0,0 +1,43 @@
+/*
+ *  Copyright (c) 2022 Jeremy HU <jeremy-at-dust3d dot org>. All rights reserved. 
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#ifndef HU_BASE_DEFLATE_H_
+#define HU_BASE_DEFLATE_H_
+
+#include <vector>
+#include <cstdint>
+
+namespace Hu
+{
+namespace Deflate
+{
+
+bool compress(const std::uint8_t *data, size_t size, std::vector<std::uint8_t> *output, int quality=8);
+bool decompress(const std::uint8_t *data, size_t size, size_t rawSize, std::vector<std::uint8_t> *output);
+
+// Whether size deflated bytes can inflate to rawSize, deflate never exceeds a 1032:1 ratio
+bool rawSizeIsPlausible(size_t size, size_t rawSize);
+
+}
+}
+
+#endif
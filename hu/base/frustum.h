@@ -0,0 +1,122 @@
+/*
+ *  Copyright (c) 2022 Jeremy HU <jeremy-at-dust3d dot org>. All rights reserved. 
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#ifndef HU_BASE_FRUSTUM_H_
+#define HU_BASE_FRUSTUM_H_
+
+#include <array>
+#include <cmath>
+#include <hu/base/vector3.h>
+#include <hu/base/matrix4x4.h>
+#include <hu/base/bounding_box.h>
+
+namespace Hu
+{
+
+class Frustum
+{
+public:
+    enum class Containment
+    {
+        Outside,
+        Intersecting,
+        Inside
+    };
+
+    inline Frustum() = default;
+
+    // Planes are taken from the rows of the combined projection * view matrix (Gribb & Hartmann),
+    // which works for perspective and orthographic projections alike
+    inline Frustum(const Matrix4x4 &viewProjectionMatrix)
+    {
+        const double *data = viewProjectionMatrix.constData();
+        for (size_t i = 0; i < 3; ++i) {
+            for (size_t j = 0; j < 4; ++j) {
+                m_planes[i * 2][j] = data[j * 4 + 3] + data[j * 4 + i];
+                m_planes[i * 2 + 1][j] = data[j * 4 + 3] - data[j * 4 + i];
+            }
+        }
+        for (auto &plane: m_planes) {
+            double length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+            if (length > 0.0) {
+                for (auto &it: plane)
+                    it /= length;
+            }
+        }
+        m_isValid = true;
+    }
+
+    inline bool isValid() const
+    {
+        return m_isValid;
+    }
+
+    inline Containment classify(const BoundingBox &box) const
+    {
+        if (box.isEmpty())
+            return Containment::Outside;
+        const Vector3 &lower = box.lower();
+        const Vector3 &upper = box.upper();
+        Containment result = Containment::Inside;
+        for (const auto &plane: m_planes) {
+            // Test the corner farthest along the plane normal first, then the nearest one
+            double farthest = plane[3], nearest = plane[3];
+            for (size_t i = 0; i < 3; ++i) {
+                if (plane[i] >= 0.0) {
+                    farthest += plane[i] * upper[i];
+                    nearest += plane[i] * lower[i];
+                } else {
+                    farthest += plane[i] * lower[i];
+                    nearest += plane[i] * upper[i];
+                }
+            }
+            if (farthest < 0.0)
+                return Containment::Outside;
+            if (nearest < 0.0)
+                result = Containment::Intersecting;
+        }
+        return result;
+    }
+
+    inline bool intersects(const BoundingBox &box) const
+    {
+        return Containment::Outside != classify(box);
+    }
+
+    inline bool intersects(const Vector3 &center, double radius) const
+    {
+        for (const auto &plane: m_planes) {
+            if (plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3] < -radius)
+                return false;
+        }
+        return true;
+    }
+
+private:
+    // Left, right, bottom, top, near, far; a point is inside when a * x + b * y + c * z + d >= 0 for all of them
+    std::array<std::array<double, 4>, 6> m_planes {};
+    bool m_isValid = false;
+};
+
+}
+
+#endif
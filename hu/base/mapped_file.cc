@@ -0,0 +1,127 @@
+/*
+ *  Copyright (c) 2022 Jeremy HU <jeremy-at-dust3d dot org>. All rights reserved. 
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include <hu/base/debug.h>
+#include <hu/base/mapped_file.h>
+#if defined(_WIN32)
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace Hu
+{
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const std::string &path)
+{
+    close();
+    
+    HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (INVALID_HANDLE_VALUE == fileHandle) {
+        huDebug << "Open file failed, path:" << path;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || 0 == fileSize.QuadPart) {
+        CloseHandle(fileHandle);
+        return false;
+    }
+    HANDLE mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (nullptr == mappingHandle) {
+        huDebug << "CreateFileMapping failed, path:" << path;
+        CloseHandle(fileHandle);
+        return false;
+    }
+    void *view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (nullptr == view) {
+        huDebug << "MapViewOfFile failed, path:" << path;
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        return false;
+    }
+    
+    m_fileHandle = fileHandle;
+    m_mappingHandle = mappingHandle;
+    m_data = (const std::uint8_t *)view;
+    m_size = (size_t)fileSize.QuadPart;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (nullptr != m_data)
+        UnmapViewOfFile(m_data);
+    if (nullptr != m_mappingHandle)
+        CloseHandle((HANDLE)m_mappingHandle);
+    if (nullptr != m_fileHandle)
+        CloseHandle((HANDLE)m_fileHandle);
+    m_data = nullptr;
+    m_size = 0;
+    m_mappingHandle = nullptr;
+    m_fileHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string &path)
+{
+    close();
+    
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (-1 == fd) {
+        huDebug << "Open file failed, path:" << path;
+        return false;
+    }
+    struct stat fileStat;
+    if (0 != fstat(fd, &fileStat) || 0 == fileStat.st_size) {
+        ::close(fd);
+        return false;
+    }
+    void *view = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (MAP_FAILED == view) {
+        huDebug << "mmap failed, path:" << path;
+        return false;
+    }
+    
+    m_data = (const std::uint8_t *)view;
+    m_size = (size_t)fileStat.st_size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (nullptr != m_data)
+        munmap((void *)m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif
+
+}
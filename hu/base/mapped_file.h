@@ -0,0 +1,83 @@
+/*
+ *  Copyright (c) 2022 Jeremy HU <jeremy-at-dust3d dot org>. All rights reserved. 
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#ifndef HU_BASE_MAPPED_FILE_H_
+#define HU_BASE_MAPPED_FILE_H_
+
+#include <string>
+#include <span>
+#include <cstdint>
+
+namespace Hu
+{
+
+class MappedFile
+{
+public:
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    
+    MappedFile() = default;
+    
+    MappedFile(const std::string &path)
+    {
+        open(path);
+    }
+    
+    ~MappedFile()
+    {
+        close();
+    }
+    
+    bool open(const std::string &path);
+    void close();
+    
+    bool isOpen() const
+    {
+        return nullptr != m_data;
+    }
+    
+    const std::uint8_t *data() const
+    {
+        return m_data;
+    }
+    
+    size_t size() const
+    {
+        return m_size;
+    }
+    
+    std::span<const std::uint8_t> bytes() const
+    {
+        return std::span<const std::uint8_t>(m_data, m_size);
+    }
+    
+private:
+    const std::uint8_t *m_data = nullptr;
+    size_t m_size = 0;
+    void *m_fileHandle = nullptr;
+    void *m_mappingHandle = nullptr;
+};
+
+}
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ *  Copyright (c) 2022 Jeremy HU <jeremy-at-dust3d dot org>. All rights reserved. 
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#ifndef HU_BASE_PARALLEL_FOR_H_
+#define HU_BASE_PARALLEL_FOR_H_
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <exception>
+
+namespace Hu
+{
+
+// One worker per core but one, started on first use and kept for the life of the process, so 
+// parallel loops pay a wake up instead of a thread start up
+class ThreadPool
+{
+public:
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    
+    static ThreadPool &instance()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+    
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wakeCondition.notify_all();
+        for (auto &thread: m_threads)
+            thread.join();
+    }
+    
+    // Workers plus the calling thread
+    size_t threadCount() const
+    {
+        return m_threads.size() + 1;
+    }
+    
+    // Run job(0) ... job(count - 1) on the calling thread and up to threadCount - 1 workers. Returns false 
+    // without running anything when the pool is busy with another loop, including when called from a job. 
+    // The first exception thrown by a job stops the loop and is rethrown here once every worker has left it
+    bool run(size_t count, const std::function<void (size_t index)> &job, size_t threadCount)
+    {
+        if (m_isBusy.exchange(true))
+            return false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_job = &job;
+            m_count = count;
+            m_nextIndex = 0;
+            m_joinSlots = std::min(threadCount, this->threadCount()) - 1;
+            ++m_batch;
+        }
+        m_wakeCondition.notify_all();
+        runJob();
+        std::exception_ptr exception;
+        {
+            // Every index is taken by now, workers still inside a job finish it before leaving
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_joinSlots = 0;
+            m_doneCondition.wait(lock, [&]() {
+                return 0 == m_activeWorkers;
+            });
+            m_job = nullptr;
+            std::swap(exception, m_exception);
+        }
+        m_isBusy = false;
+        if (exception)
+            std::rethrow_exception(exception);
+        return true;
+    }
+    
+private:
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeCondition;
+    std::condition_variable m_doneCondition;
+    std::atomic<bool> m_isBusy = false;
+    bool m_stop = false;
+    size_t m_batch = 0;
+    size_t m_joinSlots = 0;
+    size_t m_activeWorkers = 0;
+    const std::function<void (size_t index)> *m_job = nullptr;
+    size_t m_count = 0;
+    std::atomic<size_t> m_nextIndex = 0;
+    std::exception_ptr m_exception;
+    
+    ThreadPool()
+    {
+        size_t workerCount = std::max((size_t)std::thread::hardware_concurrency(), (size_t)1) - 1;
+        m_threads.reserve(workerCount);
+        for (size_t i = 0; i < workerCount; ++i)
+            m_threads.emplace_back(&ThreadPool::work, this);
+    }
+    
+    void runJob()
+    {
+        try {
+            for (size_t i = m_nextIndex++; i < m_count; i = m_nextIndex++)
+                (*m_job)(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_exception)
+                m_exception = std::current_exception();
+            m_nextIndex = m_count;
+        }
+    }
+    
+    void work()
+    {
+        size_t lastBatch = 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_wakeCondition.wait(lock, [&]() {
+                return m_stop || lastBatch != m_batch;
+            });
+            if (m_stop)
+                return;
+            lastBatch = m_batch;
+            if (0 == m_joinSlots)
+                continue;
+            --m_joinSlots;
+            ++m_activeWorkers;
+            lock.unlock();
+            runJob();
+            lock.lock();
+            if (0 == --m_activeWorkers)
+                m_doneCondition.notify_all();
+        }
+    }
+};
+
+// Run job(0) ... job(count - 1) on up to maxThreads threads (0 means all the pool has), the calling thread takes part. 
+// Loops started while the pool is busy, such as nested ones, run on the calling thread alone
+inline void parallelFor(size_t count, const std::function<void (size_t index)> &job, size_t maxThreads=0)
+{
+    if (count <= 1 || 1 == maxThreads) {
+        for (size_t i = 0; i < count; ++i)
+            job(i);
+        return;
+    }
+    ThreadPool &pool = ThreadPool::instance();
+    size_t threadCount = std::min(0 == maxThreads ? pool.threadCount() : maxThreads, count);
+    if (threadCount > 1 && pool.run(count, job, threadCount))
+        return;
+    for (size_t i = 0; i < count; ++i)
+        job(i);
+}
+
+}
+
+#endif
@@ -23,6 +23,7 @@
 #ifndef HU_BASE_UUID_H_
 #define HU_BASE_UUID_H_
 
+#include <cstdint>
 #include <random>
 #include <sstream>
 #include <chrono>
@@ -47,10 +48,15 @@ public:
         {
             return m_randomDistribution(m_randomGenerator);
         }
+        
+        std::uint64_t generate64()
+        {
+            return m_randomGenerator();
+        }
     
     private:
         std::random_device m_randomDevice;
-        std::mt19937 m_randomGenerator;
+        std::mt19937_64 m_randomGenerator;
         std::uniform_int_distribution<int> m_randomDistribution;
     };
 
@@ -81,45 +87,22 @@ public:
     
     static Uuid createUuid()
     {
-        std::ostringstream ss;
-        ss << std::hex;
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << "-";
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << "-";
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << "-";
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << "-";
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        ss << m_generator->generate();
-        return Uuid(ss.str());
+        static const char *digits = "0123456789abcdef";
+        std::uint64_t high = m_generator->generate64();
+        std::uint64_t low = m_generator->generate64();
+        Uuid uuid;
+        uuid.m_uuid.resize(sizeof("hhhhhhhh-hhhh-hhhh-hhhh-hhhhhhhhhhhh") - 1);
+        char *output = uuid.m_uuid.data();
+        for (int i = 0, nibble = 0; i < (int)uuid.m_uuid.size(); ++i) {
+            if (8 == i || 13 == i || 18 == i || 23 == i) {
+                output[i] = '-';
+                continue;
+            }
+            std::uint64_t bits = nibble < 16 ? high : low;
+            output[i] = digits[(bits >> ((15 - (nibble % 16)) * 4)) & 0xf];
+            ++nibble;
+        }
+        return uuid;
     }
     
     const std::string &toString() const
@@ -128,6 +111,8 @@ public:
     }
     
 private:
+    Uuid() = default;
+    
     friend struct std::hash<Uuid>;
     friend bool operator==(const Uuid &left, const Uuid &right);
     friend bool operator!=(const Uuid &left, const Uuid &right);
@@ -0,0 +1,404 @@
+/*
+ *  Copyright (c) 2022 Jeremy HU <jeremy-at-dust3d dot org>. All rights reserved. 
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#ifndef HU_BASE_XML_READER_H_
+#define HU_BASE_XML_READER_H_
+
+#include <cstring>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace Hu
+{
+
+// Forward only, in-situ XML reader. Nothing is copied: names and attribute values are views into the
+// input text, entities are decoded in place, the same way rapidxml does it with default flags.
+// Text content, comments, processing instructions, CDATA and DOCTYPE are skipped.
+class XmlReader
+{
+public:
+    enum class Token
+    {
+        StartElement,
+        EndElement,
+        EndOfDocument,
+        Error
+    };
+    
+    struct Attribute
+    {
+        std::string_view name;
+        std::string_view value;
+    };
+    
+    XmlReader(char *text):
+        m_position(text)
+    {
+    }
+    
+    // A self-closing element is reported as StartElement followed by EndElement
+    Token next()
+    {
+        if (m_pendingEndElement) {
+            m_pendingEndElement = false;
+            --m_depth;
+            return Token::EndElement;
+        }
+        for (;;) {
+            while ('\0' != *m_position && '<' != *m_position)
+                ++m_position;
+            if ('\0' == *m_position) {
+                if (0 != m_depth)
+                    return fail("unexpected end of data");
+                return Token::EndOfDocument;
+            }
+            char *tagBegin = m_position;
+            ++m_position;
+            int skipped = skipMarkup();
+            if (-1 == skipped)
+                return Token::Error;
+            if (1 == skipped)
+                continue;
+            if ('/' == *m_position) {
+                ++m_position;
+                m_name = parseName();
+                skipWhitespace();
+                if ('>' != *m_position)
+                    return fail("expected >");
+                ++m_position;
+                if (0 == m_depth)
+                    return fail("unexpected closing tag");
+                --m_depth;
+                return Token::EndElement;
+            }
+            m_elementBegin = tagBegin;
+            return parseStartElement();
+        }
+    }
+    
+    // Skip the rest of the element just started, including its matching EndElement. Tags inside are 
+    // only scanned for their boundaries, attributes are neither tokenized nor decoded, so the skipped text 
+    // stays intact and can be kept from elementBegin() to position()
+    bool skipElement()
+    {
+        if (m_pendingEndElement) {
+            m_pendingEndElement = false;
+            --m_depth;
+            return true;
+        }
+        size_t openCount = 1;
+        while (openCount > 0) {
+            char *found = std::strchr(m_position, '<');
+            if (nullptr == found) {
+                fail("unexpected end of data");
+                return false;
+            }
+            m_position = found + 1;
+            int skipped = skipMarkup();
+            if (-1 == skipped)
+                return false;
+            if (1 == skipped)
+                continue;
+            bool isEndTag = '/' == *m_position;
+            bool isSelfClosing = false;
+            for (;;) {
+                char c = *m_position;
+                if ('\0' == c) {
+                    fail("expected >");
+                    return false;
+                }
+                if ('"' == c || '\'' == c) {
+                    char *quoteEnd = std::strchr(m_position + 1, c);
+                    if (nullptr == quoteEnd) {
+                        fail("expected ' or \"");
+                        return false;
+                    }
+                    m_position = quoteEnd + 1;
+                    continue;
+                }
+                if ('>' == c) {
+                    isSelfClosing = '/' == m_position[-1];
+                    ++m_position;
+                    break;
+                }
+                ++m_position;
+            }
+            if (isEndTag)
+                --openCount;
+            else if (!isSelfClosing)
+                ++openCount;
+        }
+        --m_depth;
+        return true;
+    }
+    
+    // Start of the '<' of the last element started
+    const char *elementBegin() const
+    {
+        return m_elementBegin;
+    }
+    
+    // Where reading continues, right after the last tag consumed
+    const char *position() const
+    {
+        return m_position;
+    }
+    
+    // Number of open elements, the element just started is included
+    size_t depth() const
+    {
+        return m_depth;
+    }
+    
+    std::string_view name() const
+    {
+        return m_name;
+    }
+    
+    const std::vector<Attribute> &attributes() const
+    {
+        return m_attributes;
+    }
+    
+    const Attribute *findAttribute(std::string_view name) const
+    {
+        for (const auto &attribute: m_attributes) {
+            if (attribute.name == name)
+                return &attribute;
+        }
+        return nullptr;
+    }
+    
+    const char *error() const
+    {
+        return m_error;
+    }
+    
+private:
+    char *m_position = nullptr;
+    char *m_elementBegin = nullptr;
+    size_t m_depth = 0;
+    bool m_pendingEndElement = false;
+    std::string_view m_name;
+    std::vector<Attribute> m_attributes;
+    const char *m_error = "";
+    
+    Token fail(const char *error)
+    {
+        m_error = error;
+        return Token::Error;
+    }
+    
+    static bool isWhitespace(char c)
+    {
+        return ' ' == c || '\t' == c || '\r' == c || '\n' == c;
+    }
+    
+    void skipWhitespace()
+    {
+        while (isWhitespace(*m_position))
+            ++m_position;
+    }
+    
+    // Skip a comment, CDATA, processing instruction or declaration right after '<'. 
+    // Returns 1 when skipped, 0 when it's a tag, -1 on error
+    int skipMarkup()
+    {
+        const char *error = nullptr;
+        if ('?' == *m_position) {
+            if (!skipPast("?>"))
+                error = "expected ?>";
+        } else if ('!' == *m_position) {
+            if (0 == std::strncmp(m_position, "!--", 3)) {
+                if (!skipPast("-->"))
+                    error = "expected -->";
+            } else if (0 == std::strncmp(m_position, "![CDATA[", 8)) {
+                if (!skipPast("]]>"))
+                    error = "expected ]]>";
+            } else if (!skipDeclaration()) {
+                error = "expected >";
+            }
+        } else {
+            return 0;
+        }
+        if (nullptr != error) {
+            fail(error);
+            return -1;
+        }
+        return 1;
+    }
+    
+    bool skipPast(const char *terminator)
+    {
+        const char *found = std::strstr(m_position, terminator);
+        if (nullptr == found)
+            return false;
+        m_position += (found - m_position) + std::strlen(terminator);
+        return true;
+    }
+    
+    bool skipDeclaration()
+    {
+        int bracketDepth = 0;
+        for (; '\0' != *m_position; ++m_position) {
+            if ('[' == *m_position)
+                ++bracketDepth;
+            else if (']' == *m_position)
+                --bracketDepth;
+            else if ('>' == *m_position && bracketDepth <= 0) {
+                ++m_position;
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    std::string_view parseName()
+    {
+        char *begin = m_position;
+        while ('\0' != *m_position && !isWhitespace(*m_position) && 
+                '/' != *m_position && '>' != *m_position && '?' != *m_position && '=' != *m_position)
+            ++m_position;
+        return std::string_view(begin, m_position - begin);
+    }
+    
+    Token parseStartElement()
+    {
+        m_name = parseName();
+        if (m_name.empty())
+            return fail("expected element name");
+        m_attributes.clear();
+        for (;;) {
+            skipWhitespace();
+            if ('>' == *m_position) {
+                ++m_position;
+                ++m_depth;
+                return Token::StartElement;
+            }
+            if ('/' == *m_position) {
+                ++m_position;
+                if ('>' != *m_position)
+                    return fail("expected >");
+                ++m_position;
+                ++m_depth;
+                m_pendingEndElement = true;
+                return Token::StartElement;
+            }
+            std::string_view attributeName = parseName();
+            if (attributeName.empty())
+                return fail("expected attribute name");
+            skipWhitespace();
+            if ('=' != *m_position)
+                return fail("expected =");
+            ++m_position;
+            skipWhitespace();
+            char quote = *m_position;
+            if ('"' != quote && '\'' != quote)
+                return fail("expected ' or \"");
+            ++m_position;
+            char *begin = m_position;
+            char *end = begin;
+            while ('\0' != *m_position && quote != *m_position) {
+                if ('&' == *m_position)
+                    decodeEntity(&end);
+                else
+                    *end++ = *m_position++;
+            }
+            if ('\0' == *m_position)
+                return fail("expected ' or \"");
+            ++m_position;
+            m_attributes.push_back({attributeName, std::string_view(begin, end - begin)});
+        }
+    }
+    
+    void decodeEntity(char **end)
+    {
+        static const struct {
+            const char *name;
+            size_t length;
+            char character;
+        } entities[] = {
+            {"&lt;", 4, '<'},
+            {"&gt;", 4, '>'},
+            {"&amp;", 5, '&'},
+            {"&apos;", 6, '\''},
+            {"&quot;", 6, '"'}
+        };
+        for (const auto &entity: entities) {
+            if (0 == std::strncmp(m_position, entity.name, entity.length)) {
+                *(*end)++ = entity.character;
+                m_position += entity.length;
+                return;
+            }
+        }
+        if ('#' == m_position[1]) {
+            char *position = m_position + 2;
+            std::uint32_t code = 0;
+            bool hex = 'x' == *position;
+            if (hex)
+                ++position;
+            char *digitsBegin = position;
+            for (;; ++position) {
+                char c = *position;
+                if (c >= '0' && c <= '9')
+                    code = code * (hex ? 16 : 10) + (c - '0');
+                else if (hex && c >= 'a' && c <= 'f')
+                    code = code * 16 + (c - 'a' + 10);
+                else if (hex && c >= 'A' && c <= 'F')
+                    code = code * 16 + (c - 'A' + 10);
+                else
+                    break;
+            }
+            if (position != digitsBegin && ';' == *position) {
+                appendUtf8(end, code);
+                m_position = position + 1;
+                return;
+            }
+        }
+        *(*end)++ = *m_position++;
+    }
+    
+    static void appendUtf8(char **end, std::uint32_t code)
+    {
+        char *&output = *end;
+        if (code < 0x80) {
+            *output++ = (char)code;
+        } else if (code < 0x800) {
+            *output++ = (char)(0xc0 | (code >> 6));
+            *output++ = (char)(0x80 | (code & 0x3f));
+        } else if (code < 0x10000) {
+            *output++ = (char)(0xe0 | (code >> 12));
+            *output++ = (char)(0x80 | ((code >> 6) & 0x3f));
+            *output++ = (char)(0x80 | (code & 0x3f));
+        } else {
+            *output++ = (char)(0xf0 | (code >> 18));
+            *output++ = (char)(0x80 | ((code >> 12) & 0x3f));
+            *output++ = (char)(0x80 | ((code >> 6) & 0x3f));
+            *output++ = (char)(0x80 | (code & 0x3f));
+        }
+    }
+};
+
+}
+
+#endif
@@ -23,6 +23,7 @@
 #ifndef HU_GLES_ICON_MAP_H_
 #define HU_GLES_ICON_MAP_H_
 
+#include <map>
 #include <hu/base/debug.h>
 #include <hu/gles/shader.h>
 #include <GLES2/gl2.h>
@@ -23,6 +23,7 @@
 #ifndef HU_GLES_IMAGE_MAP_H_
 #define HU_GLES_IMAGE_MAP_H_
 
+#include <map>
 #include <hu/base/image.h>
 #include <hu/gles/shader.h>
 
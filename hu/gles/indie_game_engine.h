@@ -23,10 +23,17 @@
 #ifndef HU_GLES_INDIE_GAME_ENGINE_H_
 #define HU_GLES_INDIE_GAME_ENGINE_H_
 
+#include <algorithm>
 #include <string>
 #include <functional>
+#include <map>
+#include <tuple>
+#include <vector>
+#include <hu/base/bounding_box.h>
+#include <hu/base/bounding_volume_hierarchy.h>
 #include <hu/base/color.h>
 #include <hu/base/debug.h>
+#include <hu/base/frustum.h>
 #include <hu/base/matrix4x4.h>
 #include <hu/base/quaternion.h>
 #include <hu/base/task.h>
@@ -137,6 +144,7 @@ public:
             m_renderType(renderType)
         {
             m_vertexBufferList = m_engine.createObjectVertexBufferList(resourceName);
+            updateBoundingVolumes();
         }
         
         ~Object()
@@ -154,9 +162,48 @@ public:
             return m_localMatrix;
         }
         
+        // The first move takes the object out of the static hierarchy, from then on it is culled on its own
         void updateWorldMatrix(const Matrix4x4 &matrix)
         {
             m_worldMatrix = matrix;
+            updateBoundingVolumes();
+            if (!m_isMoving) {
+                m_isMoving = true;
+                m_engine.m_cullingObjectsAreDirty = true;
+            }
+        }
+        
+        // World space box and sphere around all vertex buffers, empty when no buffer knows its positions
+        const BoundingBox &boundingBox() const
+        {
+            return m_boundingBox;
+        }
+        
+        const Vector3 &boundingSphereCenter() const
+        {
+            return m_boundingSphereCenter;
+        }
+        
+        double boundingSphereRadius() const
+        {
+            return m_boundingSphereRadius;
+        }
+        
+        bool isMoving() const
+        {
+            return m_isMoving;
+        }
+        
+        // True once any vertex buffer's bounds changed after the last updateBoundingVolumes()
+        bool boundingVolumesAreOutdated() const
+        {
+            if (nullptr == m_vertexBufferList)
+                return false;
+            for (const auto &vertexBuffer: *m_vertexBufferList) {
+                if (vertexBuffer.boundingBoxRevision() > m_boundingBoxRevision)
+                    return true;
+            }
+            return false;
         }
         
         std::vector<VertexBuffer> *vertexBufferList() const
@@ -177,6 +224,31 @@ public:
         std::string m_id;
         std::string m_resourceName;
         std::vector<VertexBuffer> *m_vertexBufferList = nullptr;
+        BoundingBox m_boundingBox;
+        Vector3 m_boundingSphereCenter;
+        double m_boundingSphereRadius = 0.0;
+        bool m_isMoving = false;
+        uint64_t m_visibleCullStamp = 0;
+        uint64_t m_boundingBoxRevision = 0;
+        
+        friend class IndieGameEngine;
+        
+        void updateBoundingVolumes()
+        {
+            BoundingBox localBoundingBox;
+            m_boundingBoxRevision = 0;
+            if (nullptr != m_vertexBufferList) {
+                for (const auto &vertexBuffer: *m_vertexBufferList) {
+                    localBoundingBox.unite(vertexBuffer.boundingBox());
+                    m_boundingBoxRevision = std::max(m_boundingBoxRevision, vertexBuffer.boundingBoxRevision());
+                }
+            }
+            m_boundingBox = localBoundingBox.transformed(m_worldMatrix);
+            if (m_boundingBox.isEmpty())
+                return;
+            m_boundingSphereCenter = m_boundingBox.center();
+            m_boundingSphereRadius = m_boundingBox.radius();
+        }
     };
     
     bool addObject(const std::string &id, const std::string &resourceName, const Matrix4x4 &modelMatrix, RenderType renderType=RenderType::Default)
@@ -186,6 +258,7 @@ public:
             return false;
         }
         m_objects.insert({id, std::make_unique<Object>(*this, id, resourceName, modelMatrix, renderType)});
+        m_cullingObjectsAreDirty = true;
         return true;
     }
     
@@ -231,65 +304,293 @@ public:
         }
     }
     
+    // Describes a GLfloat buffer the way the fixed layouts of each draw hint always read it
+    static VertexLayout floatVertexLayout(uint32_t drawHint, size_t numbersPerVertex)
+    {
+        VertexLayout layout;
+        switch (drawHint) {
+            case DrawHint::Triangles:
+                layout.addAttribute(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 3);
+                layout.addAttribute(1, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 3);
+                if (numbersPerVertex >= 9)
+                    layout.addAttribute(2, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 3);
+                layout.setStride(sizeof(GLfloat) * numbersPerVertex);
+                break;
+            case DrawHint::Lines:
+                layout.addAttribute(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 3);
+                layout.setStride(sizeof(GLfloat) * numbersPerVertex);
+                break;
+            case DrawHint::Texture:
+                layout.addAttribute(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 3);
+                layout.addAttribute(1, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 2);
+                break;
+        }
+        return layout;
+    }
+    
     void drawVertexBuffer(VertexBuffer &vertexBuffer)
     {
-        if (vertexBuffer.begin()) {
-            switch (vertexBuffer.drawHint()) {
-                case DrawHint::Triangles:
-                    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * vertexBuffer.numbersPerVertex(), nullptr);
-                    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * vertexBuffer.numbersPerVertex(), (const void *)(sizeof(GLfloat) * 3));
-                    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * vertexBuffer.numbersPerVertex(), (const void *)(sizeof(GLfloat) * 6));
-                    glEnableVertexAttribArray(0);
-                    glEnableVertexAttribArray(1);
-                    glEnableVertexAttribArray(2);
-                    glDrawArrays(GL_TRIANGLES, 0, vertexBuffer.vertexCount());
-                    glDisableVertexAttribArray(0);
-                    glDisableVertexAttribArray(1);
-                    glDisableVertexAttribArray(2);
-                    break;
-                case DrawHint::Lines:
-                    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * vertexBuffer.numbersPerVertex(), nullptr);
-                    glEnableVertexAttribArray(0);
-                    glDrawArrays(GL_LINES, 0, vertexBuffer.vertexCount());
-                    glDisableVertexAttribArray(0);
-                    break;
-                case DrawHint::Texture:
-                    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 5, nullptr);
-                    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 5, (const void *)(sizeof(GLfloat) * 3));
-                    glEnableVertexAttribArray(0);
-                    glEnableVertexAttribArray(1);
-                    glDrawArrays(GL_TRIANGLE_FAN, 0, vertexBuffer.vertexCount());
-                    glDisableVertexAttribArray(0);
-                    glDisableVertexAttribArray(1);
-                    break;
+        drawBoundVertexBuffer(vertexBuffer);
+        resetVertexState();
+    }
+    
+    // Draws without restoring attribute state, so a following draw from the same buffer skips the binding 
+    // and attribute pointer setup. With vertex array objects switching buffers is a single bind, otherwise 
+    // only the attributes that differ are toggled. Call resetVertexState() before drawing anything else. 
+    // More than one instance reads per instance matrices from the instance buffer, starting at firstInstance
+    void drawBoundVertexBuffer(VertexBuffer &vertexBuffer, size_t instanceCount=1, size_t firstInstance=0)
+    {
+        if (&vertexBuffer != m_boundVertexBuffer) {
+            if (nullptr != m_boundVertexBuffer)
+                unbindVertexBuffer();
+            if (vertexBuffer.layout().isEmpty())
+                vertexBuffer.setLayout(floatVertexLayout(vertexBuffer.drawHint(), vertexBuffer.numbersPerVertex()));
+            if (vertexBuffer.bindVertexArray()) {
+                m_vertexArrayIsBound = true;
+            } else {
+                if (!vertexBuffer.begin())
+                    return;
+                const VertexLayout &layout = vertexBuffer.layout();
+                uint32_t enabledVertexAttributes = 0;
+                for (const auto &attribute: layout.attributes()) {
+                    glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized, layout.stride(), (const void *)attribute.offset);
+                    enabledVertexAttributes |= 1u << attribute.location;
+                }
+                setEnabledVertexAttributes(enabledVertexAttributes);
             }
-            vertexBuffer.end();
+            m_boundVertexBuffer = &vertexBuffer;
         }
+        const VertexLayout &layout = vertexBuffer.layout();
+        GLenum mode = GL_TRIANGLES;
+        switch (vertexBuffer.drawHint()) {
+            case DrawHint::Triangles:
+                if (!layout.hasAttribute(2))
+                    glVertexAttrib4f(2, 1.0f, 1.0f, 1.0f, 1.0f);
+                break;
+            case DrawHint::Lines:
+                mode = GL_LINES;
+                break;
+            case DrawHint::Texture:
+                mode = GL_TRIANGLE_FAN;
+                break;
+        }
+        if (instanceCount > 1) {
+            glBindBuffer(GL_ARRAY_BUFFER, m_instanceBufferId);
+            for (GLuint column = 0; column < 4; ++column) {
+                GLuint location = m_instanceMatrixLocation + column;
+                glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 16, 
+                    (const void *)(sizeof(GLfloat) * (16 * firstInstance + 4 * column)));
+                m_vertexAttribDivisor(location, 1);
+                glEnableVertexAttribArray(location);
+            }
+            if (vertexBuffer.indexCount() > 0)
+                m_drawElementsInstanced(mode, vertexBuffer.indexCount(), vertexBuffer.indexType(), nullptr, instanceCount);
+            else
+                m_drawArraysInstanced(mode, 0, vertexBuffer.vertexCount(), instanceCount);
+            for (GLuint column = 0; column < 4; ++column) {
+                m_vertexAttribDivisor(m_instanceMatrixLocation + column, 0);
+                glDisableVertexAttribArray(m_instanceMatrixLocation + column);
+            }
+            m_instanceMatrixIsIdentity = false;
+            return;
+        }
+        if (!m_instanceMatrixIsIdentity) {
+            for (GLuint column = 0; column < 4; ++column)
+                glVertexAttrib4f(m_instanceMatrixLocation + column, 0 == column, 1 == column, 2 == column, 3 == column);
+            m_instanceMatrixIsIdentity = true;
+        }
+        if (vertexBuffer.indexCount() > 0)
+            glDrawElements(mode, vertexBuffer.indexCount(), vertexBuffer.indexType(), nullptr);
+        else
+            glDrawArrays(mode, 0, vertexBuffer.vertexCount());
     }
     
-    void renderObjects(Shader &shader, RenderType renderType, DrawHint drawHint, const Matrix4x4 *modelModifyMatrix=nullptr)
+    // GLES3 core entry points, or ANGLE_instanced_arrays on GLES2
+    static bool isInstancingSupported()
     {
+        if (!m_instancingIsChecked) {
+            m_instancingIsChecked = true;
+            const char *versionString = (const char *)glGetString(GL_VERSION);
+            const char *extensionString = (const char *)glGetString(GL_EXTENSIONS);
+            if (nullptr != versionString && nullptr != strstr(versionString, "OpenGL ES 3")) {
+                m_drawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDANGLEPROC)eglGetProcAddress("glDrawArraysInstanced");
+                m_drawElementsInstanced = (PFNGLDRAWELEMENTSINSTANCEDANGLEPROC)eglGetProcAddress("glDrawElementsInstanced");
+                m_vertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORANGLEPROC)eglGetProcAddress("glVertexAttribDivisor");
+            } else if (nullptr != extensionString && nullptr != strstr(extensionString, "GL_ANGLE_instanced_arrays")) {
+                m_drawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDANGLEPROC)eglGetProcAddress("glDrawArraysInstancedANGLE");
+                m_drawElementsInstanced = (PFNGLDRAWELEMENTSINSTANCEDANGLEPROC)eglGetProcAddress("glDrawElementsInstancedANGLE");
+                m_vertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORANGLEPROC)eglGetProcAddress("glVertexAttribDivisorANGLE");
+            }
+            if (nullptr == m_drawArraysInstanced || nullptr == m_drawElementsInstanced || nullptr == m_vertexAttribDivisor)
+                m_drawArraysInstanced = nullptr;
+        }
+        return nullptr != m_drawArraysInstanced;
+    }
+    
+    void resetVertexState()
+    {
+        if (nullptr != m_boundVertexBuffer)
+            unbindVertexBuffer();
+        setEnabledVertexAttributes(0);
+    }
+    
+    // One item per object and vertex buffer, sorted by draw hint, then vertex layout and buffer so each pass 
+    // visits a contiguous range and neighbouring draws share as much GL state as possible
+    void buildRenderQueue()
+    {
+        m_renderQueue.clear();
         for (const auto &objectIt: m_objects) {
-            const Object &object = *objectIt.second;
-            if (!(object.renderType() & renderType))
-                continue;
-            std::vector<VertexBuffer> *vertexBufferList = object.vertexBufferList();
+            const Object *object = objectIt.second.get();
+            std::vector<VertexBuffer> *vertexBufferList = object->vertexBufferList();
             if (nullptr == vertexBufferList)
                 continue;
-            GLfloat matrixData[16];
-            if (nullptr != modelModifyMatrix) {
-                Matrix4x4 matrix = object.worldMatrix() * (*modelModifyMatrix);
-                matrix.getData(matrixData);
-            } else {
-                object.worldMatrix().getData(matrixData);
-            }
-            glUniformMatrix4fv(shader.getUniformLocation("modelMatrix"), 1, GL_FALSE, &matrixData[0]);
             for (auto &vertexBuffer: *vertexBufferList) {
-                if (!(vertexBuffer.drawHint() & drawHint))
+                if (vertexBuffer.layout().isEmpty())
+                    vertexBuffer.setLayout(floatVertexLayout(vertexBuffer.drawHint(), vertexBuffer.numbersPerVertex()));
+                m_renderQueue.push_back({object, &vertexBuffer, vertexBuffer.drawHint(), vertexBuffer.layout().key()});
+            }
+        }
+        std::sort(m_renderQueue.begin(), m_renderQueue.end(), [](const DrawItem &first, const DrawItem &second) {
+            return std::tie(first.drawHint, first.layoutKey, first.vertexBuffer, first.object) < 
+                std::tie(second.drawHint, second.layoutKey, second.vertexBuffer, second.object);
+        });
+    }
+    
+    // Objects which never moved go into a bounding volume hierarchy, rebuilt only when objects are added or 
+    // start moving. Moving objects, and those without known bounds, are kept in a list tested one by one
+    void buildCullingObjects()
+    {
+        m_staticObjects.clear();
+        m_movingObjects.clear();
+        std::vector<BoundingBox> boxes;
+        for (const auto &objectIt: m_objects) {
+            Object *object = objectIt.second.get();
+            if (object->isMoving() || object->boundingBox().isEmpty()) {
+                m_movingObjects.push_back(object);
+                continue;
+            }
+            m_staticObjects.push_back(object);
+            boxes.push_back(object->boundingBox());
+        }
+        m_staticObjectHierarchy.build(boxes);
+        m_cullingObjectsAreDirty = false;
+    }
+    
+    // Objects whose resource had its vertices replaced or edited since the last check get new bounds, 
+    // a changed static object also invalidates the hierarchy. Frames without edits cost one compare
+    void updateCullingBoundingVolumes()
+    {
+        if (VertexBuffer::lastBoundingBoxRevision() == m_cullingBoundingBoxRevision)
+            return;
+        for (const auto &objectIt: m_objects) {
+            Object *object = objectIt.second.get();
+            if (!object->boundingVolumesAreOutdated())
+                continue;
+            object->updateBoundingVolumes();
+            if (!object->isMoving())
+                m_cullingObjectsAreDirty = true;
+        }
+        m_cullingBoundingBoxRevision = VertexBuffer::lastBoundingBoxRevision();
+    }
+    
+    // Marks the objects renderObjects() draws until the next call, those entirely outside of the frustum are skipped
+    void cullObjects(const Frustum &frustum)
+    {
+        updateCullingBoundingVolumes();
+        if (m_cullingObjectsAreDirty)
+            buildCullingObjects();
+        ++m_cullStamp;
+        m_staticObjectHierarchy.query(frustum, [&](size_t index) {
+            m_staticObjects[index]->m_visibleCullStamp = m_cullStamp;
+        });
+        for (auto &object: m_movingObjects) {
+            if (object->boundingBox().isEmpty() || 
+                    (frustum.intersects(object->boundingSphereCenter(), object->boundingSphereRadius()) && 
+                        frustum.intersects(object->boundingBox()))) {
+                object->m_visibleCullStamp = m_cullStamp;
+            }
+        }
+    }
+    
+    // Objects sharing a vertex buffer sit next to each other in the queue. Runs of at least m_minInstanceCount 
+    // are drawn instanced: their matrices go to the instance buffer in one upload per pass and modelMatrix 
+    // is identity. Everything else is drawn one by one with the identity instance matrix
+    void renderObjects(Shader &shader, RenderType renderType, DrawHint drawHint, const Matrix4x4 *modelModifyMatrix=nullptr)
+    {
+        auto firstItem = std::lower_bound(m_renderQueue.begin(), m_renderQueue.end(), (uint32_t)drawHint, [](const DrawItem &item, uint32_t drawHint) {
+            return item.drawHint < drawHint;
+        });
+        m_passItems.clear();
+        for (auto it = firstItem; it != m_renderQueue.end() && it->drawHint == (uint32_t)drawHint; ++it) {
+            if ((it->object->renderType() & renderType) && it->object->m_visibleCullStamp == m_cullStamp)
+                m_passItems.push_back(&(*it));
+        }
+        
+        // Quantized positions are decoded by folding the layout's position matrix into the model matrix
+        auto objectMatrix = [&](const DrawItem &item) {
+            Matrix4x4 modelMatrix = nullptr != modelModifyMatrix ? item.object->worldMatrix() * (*modelModifyMatrix) : item.object->worldMatrix();
+            if (item.vertexBuffer->layout().hasPositionMatrix())
+                modelMatrix *= item.vertexBuffer->layout().positionMatrix();
+            return modelMatrix;
+        };
+        auto runEnd = [&](size_t begin) {
+            size_t end = begin + 1;
+            while (end < m_passItems.size() && m_passItems[end]->vertexBuffer == m_passItems[begin]->vertexBuffer)
+                ++end;
+            return end;
+        };
+        
+        bool instancing = isInstancingSupported();
+        if (instancing) {
+            m_instanceMatrices.clear();
+            for (size_t begin = 0, end = 0; begin < m_passItems.size(); begin = end) {
+                end = runEnd(begin);
+                if (end - begin < m_minInstanceCount)
                     continue;
-                drawVertexBuffer(vertexBuffer);
+                for (size_t i = begin; i < end; ++i) {
+                    m_instanceMatrices.resize(m_instanceMatrices.size() + 16);
+                    objectMatrix(*m_passItems[i]).getData(&m_instanceMatrices[m_instanceMatrices.size() - 16]);
+                }
+            }
+            if (!m_instanceMatrices.empty()) {
+                if (0 == m_instanceBufferId)
+                    glGenBuffers(1, &m_instanceBufferId);
+                glBindBuffer(GL_ARRAY_BUFFER, m_instanceBufferId);
+                glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * m_instanceMatrices.size(), m_instanceMatrices.data(), GL_STREAM_DRAW);
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+            }
+        }
+        
+        GLint modelMatrixLocation = shader.getUniformLocation("modelMatrix");
+        const Object *lastObject = nullptr;
+        bool modelMatrixIsDecoding = false;
+        m_instanceMatrixIsIdentity = false;
+        size_t instanceOffset = 0;
+        for (size_t begin = 0, end = 0; begin < m_passItems.size(); begin = end) {
+            end = runEnd(begin);
+            if (instancing && end - begin >= m_minInstanceCount) {
+                GLfloat matrixData[16];
+                Matrix4x4().getData(matrixData);
+                glUniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE, &matrixData[0]);
+                lastObject = nullptr;
+                drawBoundVertexBuffer(*m_passItems[begin]->vertexBuffer, end - begin, instanceOffset);
+                instanceOffset += end - begin;
+                continue;
+            }
+            for (size_t i = begin; i < end; ++i) {
+                const DrawItem &item = *m_passItems[i];
+                bool isDecoding = item.vertexBuffer->layout().hasPositionMatrix();
+                if (item.object != lastObject || isDecoding || modelMatrixIsDecoding) {
+                    GLfloat matrixData[16];
+                    objectMatrix(item).getData(matrixData);
+                    glUniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE, &matrixData[0]);
+                    lastObject = item.object;
+                    modelMatrixIsDecoding = isDecoding;
+                }
+                drawBoundVertexBuffer(*item.vertexBuffer);
             }
         }
+        resetVertexState();
     }
     
     void initialize()
@@ -718,6 +1019,8 @@ public:
         if (m_screenIsDirty) {
             
             m_screenIsDirty = false;
+            
+            buildRenderQueue();
 
             // Render shadow
             
@@ -732,6 +1035,7 @@ public:
                 lightViewProjectionMatrix = shadowProjectionMatrix * viewMatrix;
                 
                 if (m_shadowMap.begin()) {
+                    cullObjects(Frustum(lightViewProjectionMatrix));
                     glEnable(GL_DEPTH_TEST);
                     glDisable(GL_CULL_FACE); // Disable fulling face, unless there will be hole in shadow
                     m_shadowMap.shader().setUniformMatrix("viewMatrix", viewMatrix);
@@ -747,6 +1051,9 @@ public:
             Matrix4x4 projectionMatrix;
             projectionMatrix.perspectiveProject(Math::radiansFromDegrees(m_fov), (float)m_windowWidth / (float)m_windowHeight, 0.1, 100.0);
             
+            // Depth, position, id and color passes all share the camera frustum
+            cullObjects(Frustum(projectionMatrix * viewMatrix));
+            
             // Render depth
             {
                 if (m_cameraSpaceDepthMap.begin()) {
@@ -1203,6 +1510,59 @@ private:
     std::unique_ptr<Widget> m_rootWidget;
     std::map<std::string, std::pair<std::unique_ptr<std::vector<VertexBuffer>>, int64_t/*referencingCount*/>> m_vertexBufferListMap;
     std::map<std::string, std::unique_ptr<Object>> m_objects;
+    
+    struct DrawItem
+    {
+        const Object *object;
+        VertexBuffer *vertexBuffer;
+        uint32_t drawHint;
+        uint64_t layoutKey;
+    };
+    std::vector<DrawItem> m_renderQueue;
+    BoundingVolumeHierarchy m_staticObjectHierarchy;
+    std::vector<Object *> m_staticObjects;
+    std::vector<Object *> m_movingObjects;
+    bool m_cullingObjectsAreDirty = true;
+    uint64_t m_cullingBoundingBoxRevision = 0;
+    uint64_t m_cullStamp = 0;
+    VertexBuffer *m_boundVertexBuffer = nullptr;
+    uint32_t m_enabledVertexAttributes = 0;
+    bool m_vertexArrayIsBound = false;
+    static const GLuint m_instanceMatrixLocation = 4;
+    static const size_t m_minInstanceCount = 2;
+    std::vector<const DrawItem *> m_passItems;
+    std::vector<GLfloat> m_instanceMatrices;
+    GLuint m_instanceBufferId = 0;
+    bool m_instanceMatrixIsIdentity = false;
+    static inline bool m_instancingIsChecked = false;
+    static inline PFNGLDRAWARRAYSINSTANCEDANGLEPROC m_drawArraysInstanced = nullptr;
+    static inline PFNGLDRAWELEMENTSINSTANCEDANGLEPROC m_drawElementsInstanced = nullptr;
+    static inline PFNGLVERTEXATTRIBDIVISORANGLEPROC m_vertexAttribDivisor = nullptr;
+    
+    // The vertex array object goes first, so unbinding the element buffer does not detach it from the object
+    void unbindVertexBuffer()
+    {
+        if (m_vertexArrayIsBound) {
+            VertexBuffer::unbindVertexArray();
+            m_vertexArrayIsBound = false;
+        }
+        m_boundVertexBuffer->end();
+        m_boundVertexBuffer = nullptr;
+    }
+    
+    void setEnabledVertexAttributes(uint32_t enabledVertexAttributes)
+    {
+        uint32_t changedVertexAttributes = enabledVertexAttributes ^ m_enabledVertexAttributes;
+        for (GLuint location = 0; 0 != changedVertexAttributes; ++location, changedVertexAttributes >>= 1) {
+            if (0 == (changedVertexAttributes & 1))
+                continue;
+            if (enabledVertexAttributes & (1u << location))
+                glEnableVertexAttribArray(location);
+            else
+                glDisableVertexAttribArray(location);
+        }
+        m_enabledVertexAttributes = enabledVertexAttributes;
+    }
     std::map<std::string, std::unique_ptr<LocationState>> m_locationStates;
     std::map<std::string, std::unique_ptr<State>> m_generalStates;
 };
@@ -24,7 +24,10 @@
 #define HU_GLES_SHADER_H_
 
 #include <string>
-#include <map>
+#include <array>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
 #include <GLES2/gl2.h>
 #include <hu/base/color.h>
 #include <hu/base/matrix4x4.h>
@@ -32,6 +35,41 @@
 namespace Hu
 {
 
+// Names a uniform by its FNV-1a hash. The constructor is consteval, so string literals are hashed 
+// at compile time and passing one costs no more than passing an integer
+class UniformName
+{
+public:
+    consteval UniformName(const char *name) :
+        m_hash(hash(name, length(name)))
+    {
+    }
+    
+    constexpr uint64_t hash() const
+    {
+        return m_hash;
+    }
+    
+    static constexpr uint64_t hash(const char *name, size_t length)
+    {
+        uint64_t value = 0xcbf29ce484222325ull;
+        for (size_t i = 0; i < length; ++i)
+            value = (value ^ (uint8_t)name[i]) * 0x100000001b3ull;
+        return value;
+    }
+    
+private:
+    uint64_t m_hash = 0;
+    
+    static constexpr size_t length(const char *name)
+    {
+        size_t count = 0;
+        while ('\0' != name[count])
+            ++count;
+        return count;
+    }
+};
+
 class Shader
 {
 public:
@@ -41,7 +79,7 @@ public:
     {
         std::swap(m_name, other.m_name);
         std::swap(m_program, other.m_program);
-        std::swap(m_uniformLocationMap, other.m_uniformLocationMap);
+        std::swap(m_uniformLocations, other.m_uniformLocations);
     }
     
     Shader &operator=(Shader &&other)
@@ -49,7 +87,7 @@ public:
         //std::cout << "[" << name() << "] move from other:" << other.name() << std::endl;
         std::swap(m_name, other.m_name);
         std::swap(m_program, other.m_program);
-        std::swap(m_uniformLocationMap, other.m_uniformLocationMap);
+        std::swap(m_uniformLocations, other.m_uniformLocations);
         return *this;
     }
 
@@ -86,6 +124,8 @@ public:
         
         glDeleteShader(vertexShader);
         glDeleteShader(fragmentShader);
+        
+        resolveUniformLocations();
     }
     
     void use()
@@ -94,25 +134,25 @@ public:
         glUseProgram(m_program);
     }
 
-    GLuint getUniformLocation(const std::string &name)
+    // -1 for names the program does not use, which glUniform* silently ignores
+    GLint getUniformLocation(UniformName name) const
     {
-        auto findLocation = m_uniformLocationMap.find(name);
-        if (findLocation != m_uniformLocationMap.end()) {
-            return findLocation->second;
+        uint64_t hash = name.hash();
+        for (size_t i = hash & (m_uniformSlotCount - 1); ; i = (i + 1) & (m_uniformSlotCount - 1)) {
+            const UniformLocation &slot = m_uniformLocations[i];
+            if (slot.hash == hash || -1 == slot.location)
+                return slot.location;
         }
-        GLuint location = glGetUniformLocation(m_program, name.c_str());
-        m_uniformLocationMap.insert({name, location});
-        return location;
     }
     
-    void setUniformMatrix(const std::string &name, const Matrix4x4 &matrix)
+    void setUniformMatrix(UniformName name, const Matrix4x4 &matrix)
     {
         GLfloat matrixData[16];
         matrix.getData(matrixData);
         glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &matrixData[0]);
     }
     
-    void setUniformColor(const std::string &name, const Color &color)
+    void setUniformColor(UniformName name, const Color &color)
     {
         glUniform4f(getUniformLocation(name), color[0], color[1], color[2], color[3]);
     }
@@ -125,7 +165,72 @@ public:
 private:
     std::string m_name;
     GLuint m_program = 0;
-    std::map<std::string, GLuint> m_uniformLocationMap;
+    
+    struct UniformLocation
+    {
+        uint64_t hash = 0;
+        GLint location = -1;
+    };
+    
+    // Open addressed by hash, kept at most half full so a lookup is one index and rarely a second probe
+    static const size_t m_uniformSlotCount = 128;
+    std::array<UniformLocation, m_uniformSlotCount> m_uniformLocations;
+    
+    void addUniformLocation(const std::string &name, GLint location)
+    {
+        uint64_t hash = UniformName::hash(name.c_str(), name.size());
+        for (size_t i = hash & (m_uniformSlotCount - 1); ; i = (i + 1) & (m_uniformSlotCount - 1)) {
+            UniformLocation &slot = m_uniformLocations[i];
+            if (slot.hash == hash) {
+                if (slot.location != location)
+                    std::cerr << "[" << m_name << "] uniform name hash collision:" << name << "\n";
+                return;
+            }
+            if (-1 == slot.location) {
+                slot = {hash, location};
+                return;
+            }
+        }
+    }
+    
+    // Every active uniform is looked up once after linking. Arrays of basic types are listed by the driver 
+    // as "name[0]", they are also registered as "name" and by each element index
+    void resolveUniformLocations()
+    {
+        GLint uniformCount = 0;
+        glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &uniformCount);
+        GLint maxNameLength = 0;
+        glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+        std::vector<GLchar> nameBuffer(std::max(maxNameLength, (GLint)1));
+        size_t usedSlotCount = 0;
+        for (GLint i = 0; i < uniformCount; ++i) {
+            GLsizei nameLength = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(m_program, (GLuint)i, (GLsizei)nameBuffer.size(), &nameLength, &size, &type, nameBuffer.data());
+            std::string name(nameBuffer.data(), nameLength);
+            std::vector<std::string> names;
+            if (name.size() > 3 && 0 == name.compare(name.size() - 3, 3, "[0]")) {
+                std::string arrayName = name.substr(0, name.size() - 3);
+                names.push_back(arrayName);
+                for (GLint element = 0; element < size; ++element)
+                    names.push_back(arrayName + "[" + std::to_string(element) + "]");
+            } else {
+                names.push_back(name);
+            }
+            for (const auto &it: names) {
+                GLint location = glGetUniformLocation(m_program, it.c_str());
+                if (-1 == location)
+                    continue;
+                if (usedSlotCount >= m_uniformSlotCount / 2) {
+                    std::cerr << "[" << m_name << "] too many uniforms, ignored:" << it << "\n";
+                    continue;
+                }
+                addUniformLocation(it, location);
+                ++usedSlotCount;
+            }
+        }
+    }
     
     void checkCompileError(GLuint shader)
     {
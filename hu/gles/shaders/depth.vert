@@ -4,10 +4,12 @@ uniform mat4 modelMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
 layout(location = 0) in vec4 vertexPosition;
+layout(location = 4) in mat4 instanceMatrix;
 out vec4 pointColor;
 void main()
 {
-    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vertexPosition;
+    mat4 objectMatrix = modelMatrix * instanceMatrix;
+    gl_Position = projectionMatrix * viewMatrix * objectMatrix * vertexPosition;
 }
 
 )################"
\ No newline at end of file
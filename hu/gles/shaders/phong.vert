@@ -7,17 +7,19 @@ uniform mat4 lightViewProjectionMatrix;
 layout(location = 0) in vec4 vertexPosition;
 layout(location = 1) in vec4 vertexNormal;
 layout(location = 2) in vec4 vertexColor;
+layout(location = 4) in mat4 instanceMatrix;
 out vec4 pointNormal;
 out vec4 pointPosition;
 out vec4 pointColor;
 out vec4 shadowCoord;
 void main()
 {
-    pointNormal = normalize(modelMatrix * vertexNormal);
-    pointPosition = modelMatrix * vertexPosition;
+    mat4 objectMatrix = modelMatrix * instanceMatrix;
+    pointNormal = normalize(objectMatrix * vec4(vertexNormal.xyz, 0.0));
+    pointPosition = objectMatrix * vertexPosition;
     pointColor = vertexColor;
-    shadowCoord = (lightViewProjectionMatrix * modelMatrix * vertexPosition) * 0.5 + 0.5;
-    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vertexPosition;
+    shadowCoord = (lightViewProjectionMatrix * objectMatrix * vertexPosition) * 0.5 + 0.5;
+    gl_Position = projectionMatrix * viewMatrix * objectMatrix * vertexPosition;
 }
 
 )################"
\ No newline at end of file
@@ -5,11 +5,13 @@ uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
 uniform mat4 positionMatrix;
 layout(location = 0) in vec4 vertexPosition;
+layout(location = 4) in mat4 instanceMatrix;
 out vec4 pointPosition;
 void main()
 {
-    pointPosition = positionMatrix * modelMatrix * vertexPosition;
-    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vertexPosition;
+    mat4 objectMatrix = modelMatrix * instanceMatrix;
+    pointPosition = positionMatrix * objectMatrix * vertexPosition;
+    gl_Position = projectionMatrix * viewMatrix * objectMatrix * vertexPosition;
 }
 
 )################"
\ No newline at end of file
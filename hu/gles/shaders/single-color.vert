@@ -4,9 +4,11 @@ uniform mat4 modelMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
 layout(location = 0) in vec4 vertexPosition;
+layout(location = 4) in mat4 instanceMatrix;
 void main()
 {
-    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vertexPosition;
+    mat4 objectMatrix = modelMatrix * instanceMatrix;
+    gl_Position = projectionMatrix * viewMatrix * objectMatrix * vertexPosition;
 }
 
 )################"
\ No newline at end of file
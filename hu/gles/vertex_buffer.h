@@ -23,9 +23,16 @@
 #ifndef HU_GLES_VERTEX_BUFFER_H_
 #define HU_GLES_VERTEX_BUFFER_H_
 
+#include <algorithm>
 #include <memory>
 #include <vector>
+#include <cstring>
 #include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <EGL/egl.h>
+#include <EGL/eglplatform.h>
+#include <hu/base/bounding_box.h>
+#include <hu/gles/vertex_layout.h>
 
 namespace Hu
 {
@@ -37,9 +44,16 @@ public:
     
     VertexBuffer() = default;
     
-    VertexBuffer(std::unique_ptr<std::vector<GLfloat>> vertices, size_t numbersPerVertex, size_t vertexCount, uint32_t drawHint=0)
+    VertexBuffer(std::unique_ptr<std::vector<GLfloat>> vertices, size_t numbersPerVertex, size_t vertexCount, uint32_t drawHint=0, 
+            std::unique_ptr<std::vector<GLuint>> indices=nullptr)
     {
-        update(std::move(vertices), numbersPerVertex, vertexCount, drawHint);
+        update(std::move(vertices), numbersPerVertex, vertexCount, drawHint, std::move(indices));
+    }
+    
+    VertexBuffer(std::unique_ptr<std::vector<uint8_t>> vertexData, const VertexLayout &layout, size_t vertexCount, uint32_t drawHint=0, 
+            std::unique_ptr<std::vector<GLuint>> indices=nullptr)
+    {
+        update(std::move(vertexData), layout, vertexCount, drawHint, std::move(indices));
     }
     
     ~VertexBuffer()
@@ -47,32 +61,212 @@ public:
         release();
     }
     
+    // Static uploads once and frees the CPU copy. Dynamic keeps one buffer object, updates it in place and 
+    // orphans it on full replacement. Stream cycles through up to three buffer objects, so a frame never writes 
+    // the one earlier frames may still be drawing from, and keeps the last vertices on the CPU for updateRange
+    enum class Usage
+    {
+        Static,
+        Dynamic,
+        Stream
+    };
+    
+    void setUsage(Usage usage, size_t bufferCount=2)
+    {
+        release();
+        m_usage = usage;
+        m_bufferCount = Usage::Stream == usage ? std::clamp(bufferCount, (size_t)1, m_maxBufferCount) : 1;
+    }
+    
+    Usage usage() const
+    {
+        return m_usage;
+    }
+    
+    // Replaces vertexCount vertices starting at firstVertex, only for Dynamic and Stream buffers
+    bool updateRange(size_t firstVertex, size_t vertexCount, const void *data)
+    {
+        if (Usage::Static == m_usage || firstVertex + vertexCount > m_vertexCount)
+            return false;
+        size_t stride = vertexStride();
+        const uint8_t *bytes = (const uint8_t *)data;
+        if (Usage::Stream == m_usage) {
+            takePendingVertices(&m_streamData);
+            if (m_streamData.size() < (firstVertex + vertexCount) * stride)
+                return false;
+            std::copy(bytes, bytes + vertexCount * stride, m_streamData.begin() + firstVertex * stride);
+            m_streamDataIsDirty = true;
+            addToBoundingBox(bytes, vertexCount);
+            m_boundingBoxRevision = ++m_lastBoundingBoxRevision;
+            return true;
+        }
+        m_dirtyRanges.push_back({firstVertex * stride, std::vector<uint8_t>(bytes, bytes + vertexCount * stride)});
+        addToBoundingBox(bytes, vertexCount);
+        m_boundingBoxRevision = ++m_lastBoundingBoxRevision;
+        return true;
+    }
+    
     bool begin()
     {
-        if (nullptr != m_vertices) {
+        if (Usage::Static != m_usage)
+            return beginDynamic();
+        if (nullptr != m_vertices || nullptr != m_vertexData) {
             release();
         }
         if (0 == m_vertexBufferId) {
+            if (nullptr == m_vertices && nullptr == m_vertexData)
+                return false;
             glGenBuffers(1, &m_vertexBufferId);
             glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferId);
-            glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * m_numbersPerVertex * m_vertexCount, m_vertices->data(), GL_STATIC_DRAW);
-            delete m_vertices.release();
+            if (nullptr != m_vertexData) {
+                glBufferData(GL_ARRAY_BUFFER, m_layout.stride() * m_vertexCount, m_vertexData->data(), GL_STATIC_DRAW);
+                delete m_vertexData.release();
+            } else {
+                glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * m_numbersPerVertex * m_vertexCount, m_vertices->data(), GL_STATIC_DRAW);
+                delete m_vertices.release();
+            }
+            uploadIndices(GL_STATIC_DRAW);
         }
         glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferId);
+        if (0 != m_indexBufferId)
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBufferId);
         return true;
     }
     
+    // Binds a vertex array object holding this buffer's attribute setup, creating or respecifying it when 
+    // the buffer objects or layout changed. Returns false without vertex array object support, callers then 
+    // use begin() and set the attributes themselves. Call unbindVertexArray() before touching other buffers
+    bool bindVertexArray()
+    {
+        if (!isVertexArrayObjectSupported() || m_layout.isEmpty())
+            return false;
+        if (isUploadPending()) {
+            m_bindVertexArray(0);
+            if (!begin())
+                return false;
+        }
+        if (0 != m_vertexArrayId && m_vertexArrayBufferId == m_vertexBufferId && 
+                m_vertexArrayIndexBufferId == m_indexBufferId && m_vertexArrayLayoutKey == m_layout.key()) {
+            m_bindVertexArray(m_vertexArrayId);
+            return true;
+        }
+        if (0 == m_vertexArrayId)
+            m_genVertexArrays(1, &m_vertexArrayId);
+        m_bindVertexArray(m_vertexArrayId);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferId);
+        for (GLuint location = 0; location < m_maxVertexAttributeCount; ++location)
+            glDisableVertexAttribArray(location);
+        for (const auto &attribute: m_layout.attributes()) {
+            glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized, m_layout.stride(), (const void *)attribute.offset);
+            glEnableVertexAttribArray(attribute.location);
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBufferId);
+        m_vertexArrayBufferId = m_vertexBufferId;
+        m_vertexArrayIndexBufferId = m_indexBufferId;
+        m_vertexArrayLayoutKey = m_layout.key();
+        return true;
+    }
+    
+    static void unbindVertexArray()
+    {
+        if (nullptr != m_bindVertexArray)
+            m_bindVertexArray(0);
+    }
+    
+    // GL_OES_vertex_array_object on GLES2, the core entry points on GLES3
+    static bool isVertexArrayObjectSupported()
+    {
+        if (!m_vertexArrayObjectIsChecked) {
+            m_vertexArrayObjectIsChecked = true;
+            const char *versionString = (const char *)glGetString(GL_VERSION);
+            const char *extensionString = (const char *)glGetString(GL_EXTENSIONS);
+            if (nullptr != versionString && nullptr != strstr(versionString, "OpenGL ES 3")) {
+                m_genVertexArrays = (PFNGLGENVERTEXARRAYSOESPROC)eglGetProcAddress("glGenVertexArrays");
+                m_bindVertexArray = (PFNGLBINDVERTEXARRAYOESPROC)eglGetProcAddress("glBindVertexArray");
+                m_deleteVertexArrays = (PFNGLDELETEVERTEXARRAYSOESPROC)eglGetProcAddress("glDeleteVertexArrays");
+            } else if (nullptr != extensionString && nullptr != strstr(extensionString, "GL_OES_vertex_array_object")) {
+                m_genVertexArrays = (PFNGLGENVERTEXARRAYSOESPROC)eglGetProcAddress("glGenVertexArraysOES");
+                m_bindVertexArray = (PFNGLBINDVERTEXARRAYOESPROC)eglGetProcAddress("glBindVertexArrayOES");
+                m_deleteVertexArrays = (PFNGLDELETEVERTEXARRAYSOESPROC)eglGetProcAddress("glDeleteVertexArraysOES");
+            }
+            if (nullptr == m_genVertexArrays || nullptr == m_bindVertexArray || nullptr == m_deleteVertexArrays)
+                m_genVertexArrays = nullptr;
+        }
+        return nullptr != m_genVertexArrays;
+    }
+    
     void end()
     {
         glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (0 != m_indexBufferId)
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     }
     
-    void update(std::unique_ptr<std::vector<GLfloat>> vertices, size_t numbersPerVertex, size_t vertexCount, uint32_t drawHint)
+    // With indices the buffer is drawn with glDrawElements, indices are uploaded as 16 bits when the vertex count allows
+    void update(std::unique_ptr<std::vector<GLfloat>> vertices, size_t numbersPerVertex, size_t vertexCount, uint32_t drawHint, 
+        std::unique_ptr<std::vector<GLuint>> indices=nullptr)
     {
         m_vertices = std::move(vertices);
+        m_vertexData.reset();
+        m_layout = VertexLayout();
         m_numbersPerVertex = numbersPerVertex;
         m_vertexCount = vertexCount;
         m_drawHint = drawHint;
+        m_indices = std::move(indices);
+        m_indexCount = nullptr == m_indices ? 0 : m_indices->size();
+        m_dirtyRanges.clear();
+        m_boundingBox = BoundingBox();
+        if (nullptr != m_vertices && m_vertices->size() >= m_numbersPerVertex * m_vertexCount)
+            addToBoundingBox((const uint8_t *)m_vertices->data(), m_vertexCount);
+        m_boundingBoxRevision = ++m_lastBoundingBoxRevision;
+    }
+    
+    // Vertices packed as described by layout, stride() bytes each
+    void update(std::unique_ptr<std::vector<uint8_t>> vertexData, const VertexLayout &layout, size_t vertexCount, uint32_t drawHint, 
+        std::unique_ptr<std::vector<GLuint>> indices=nullptr)
+    {
+        m_vertexData = std::move(vertexData);
+        m_vertices.reset();
+        m_layout = layout;
+        m_numbersPerVertex = 0;
+        m_vertexCount = vertexCount;
+        m_drawHint = drawHint;
+        m_indices = std::move(indices);
+        m_indexCount = nullptr == m_indices ? 0 : m_indices->size();
+        m_dirtyRanges.clear();
+        m_boundingBox = BoundingBox();
+        if (nullptr != m_vertexData && m_vertexData->size() >= m_layout.stride() * m_vertexCount)
+            addToBoundingBox(m_vertexData->data(), m_vertexCount);
+        m_boundingBoxRevision = ++m_lastBoundingBoxRevision;
+    }
+    
+    // Empty for GLfloat buffers until the engine describes them on first draw
+    const VertexLayout &layout() const
+    {
+        return m_layout;
+    }
+    
+    void setLayout(const VertexLayout &layout)
+    {
+        m_layout = layout;
+    }
+    
+    // Model space bounds of the positions, computed on update() and only ever grown by updateRange()
+    const BoundingBox &boundingBox() const
+    {
+        return m_boundingBox;
+    }
+    
+    // Taken from one counter shared by all buffers, so a single compare against lastBoundingBoxRevision() 
+    // tells whether any buffer's bounds changed since then
+    uint64_t boundingBoxRevision() const
+    {
+        return m_boundingBoxRevision;
+    }
+    
+    static uint64_t lastBoundingBoxRevision()
+    {
+        return m_lastBoundingBoxRevision;
     }
     
     size_t numbersPerVertex() const
@@ -85,10 +279,37 @@ public:
         return m_vertexCount;
     }
     
+    size_t indexCount() const
+    {
+        return m_indexCount;
+    }
+    
+    GLenum indexType() const
+    {
+        return m_indexType;
+    }
+    
     void release()
     {
-        glDeleteBuffers(1, &m_vertexBufferId);
+        if (Usage::Static == m_usage) {
+            glDeleteBuffers(1, &m_vertexBufferId);
+        } else {
+            for (size_t i = 0; i < m_maxBufferCount; ++i) {
+                if (0 != m_vertexBufferIds[i])
+                    glDeleteBuffers(1, &m_vertexBufferIds[i]);
+                m_vertexBufferIds[i] = 0;
+                m_vertexBufferSizes[i] = 0;
+            }
+        }
         m_vertexBufferId = 0;
+        if (0 != m_vertexArrayId) {
+            m_deleteVertexArrays(1, &m_vertexArrayId);
+            m_vertexArrayId = 0;
+        }
+        if (0 != m_indexBufferId) {
+            glDeleteBuffers(1, &m_indexBufferId);
+            m_indexBufferId = 0;
+        }
     }
     
     uint32_t drawHint() const
@@ -97,11 +318,175 @@ public:
     }
     
 private:
+    struct DirtyRange
+    {
+        size_t offset;
+        std::vector<uint8_t> data;
+    };
+    
+    static constexpr size_t m_maxBufferCount = 3;
+    static constexpr GLuint m_maxVertexAttributeCount = 8;
+    static inline bool m_vertexArrayObjectIsChecked = false;
+    static inline PFNGLGENVERTEXARRAYSOESPROC m_genVertexArrays = nullptr;
+    static inline PFNGLBINDVERTEXARRAYOESPROC m_bindVertexArray = nullptr;
+    static inline PFNGLDELETEVERTEXARRAYSOESPROC m_deleteVertexArrays = nullptr;
+    GLuint m_vertexArrayId = 0;
+    GLuint m_vertexArrayBufferId = 0;
+    GLuint m_vertexArrayIndexBufferId = 0;
+    uint64_t m_vertexArrayLayoutKey = 0;
+    Usage m_usage = Usage::Static;
+    size_t m_bufferCount = 1;
+    size_t m_bufferIndex = 0;
+    GLuint m_vertexBufferIds[m_maxBufferCount] = {0};
+    size_t m_vertexBufferSizes[m_maxBufferCount] = {0};
+    std::vector<DirtyRange> m_dirtyRanges;
+    std::vector<uint8_t> m_streamData;
+    bool m_streamDataIsDirty = false;
     GLuint m_vertexBufferId = 0;
     size_t m_vertexCount = 0;
     size_t m_numbersPerVertex = 0;
     uint32_t m_drawHint = 0;
     std::unique_ptr<std::vector<GLfloat>> m_vertices;
+    std::unique_ptr<std::vector<uint8_t>> m_vertexData;
+    VertexLayout m_layout;
+    GLuint m_indexBufferId = 0;
+    size_t m_indexCount = 0;
+    GLenum m_indexType = GL_UNSIGNED_SHORT;
+    std::unique_ptr<std::vector<GLuint>> m_indices;
+    BoundingBox m_boundingBox;
+    uint64_t m_boundingBoxRevision = 0;
+    static inline uint64_t m_lastBoundingBoxRevision = 0;
+    
+    // Positions are the first three floats of GLfloat buffers, or the layout attribute at location 0
+    void addToBoundingBox(const uint8_t *bytes, size_t vertexCount)
+    {
+        if (0 != m_numbersPerVertex) {
+            if (m_numbersPerVertex < 3)
+                return;
+            const GLfloat *numbers = (const GLfloat *)bytes;
+            for (size_t i = 0; i < vertexCount; ++i, numbers += m_numbersPerVertex)
+                m_boundingBox.add(numbers[0], numbers[1], numbers[2]);
+            return;
+        }
+        for (const auto &attribute: m_layout.attributes()) {
+            if (0 != attribute.location)
+                continue;
+            if (GL_SHORT == attribute.type && m_layout.hasPositionMatrix()) {
+                // Packed positions never leave the decoded unit cube, so its box holds any later range update too
+                m_boundingBox.unite(BoundingBox(Vector3(-1.0, -1.0, -1.0), Vector3(1.0, 1.0, 1.0)).transformed(m_layout.positionMatrix()));
+            } else if (GL_FLOAT == attribute.type && attribute.size >= 3) {
+                for (size_t i = 0; i < vertexCount; ++i) {
+                    GLfloat values[3];
+                    memcpy(values, bytes + i * m_layout.stride() + attribute.offset, sizeof(values));
+                    m_boundingBox.add(values[0], values[1], values[2]);
+                }
+            }
+            return;
+        }
+    }
+    
+    bool isUploadPending() const
+    {
+        return 0 == m_vertexBufferId || nullptr != m_vertices || nullptr != m_vertexData || nullptr != m_indices || 
+            !m_dirtyRanges.empty() || m_streamDataIsDirty;
+    }
+    
+    size_t vertexStride() const
+    {
+        return 0 != m_numbersPerVertex ? sizeof(GLfloat) * m_numbersPerVertex : m_layout.stride();
+    }
+    
+    // Moves vertices given to update() into target, returns false when there are none
+    bool takePendingVertices(std::vector<uint8_t> *target)
+    {
+        if (nullptr != m_vertexData) {
+            target->swap(*m_vertexData);
+            delete m_vertexData.release();
+            return true;
+        }
+        if (nullptr != m_vertices) {
+            const uint8_t *bytes = (const uint8_t *)m_vertices->data();
+            target->assign(bytes, bytes + sizeof(GLfloat) * m_vertices->size());
+            delete m_vertices.release();
+            return true;
+        }
+        return false;
+    }
+    
+    // Same sized replacements orphan the old storage, so the driver does not wait for draws still reading it
+    void uploadVertices(size_t bufferIndex, const std::vector<uint8_t> &data)
+    {
+        GLenum usage = Usage::Stream == m_usage ? GL_STREAM_DRAW : GL_DYNAMIC_DRAW;
+        GLuint &bufferId = m_vertexBufferIds[bufferIndex];
+        if (0 == bufferId)
+            glGenBuffers(1, &bufferId);
+        glBindBuffer(GL_ARRAY_BUFFER, bufferId);
+        if (m_vertexBufferSizes[bufferIndex] == data.size()) {
+            glBufferData(GL_ARRAY_BUFFER, data.size(), nullptr, usage);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, data.size(), data.data());
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, data.size(), data.data(), usage);
+            m_vertexBufferSizes[bufferIndex] = data.size();
+        }
+    }
+    
+    void uploadIndices(GLenum usage)
+    {
+        if (nullptr == m_indices)
+            return;
+        if (0 == m_indexBufferId)
+            glGenBuffers(1, &m_indexBufferId);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBufferId);
+        if (m_vertexCount <= 0x10000) {
+            std::vector<GLushort> shortIndices(m_indices->begin(), m_indices->end());
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * shortIndices.size(), shortIndices.data(), usage);
+            m_indexType = GL_UNSIGNED_SHORT;
+        } else {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * m_indices->size(), m_indices->data(), usage);
+            m_indexType = GL_UNSIGNED_INT;
+        }
+        delete m_indices.release();
+    }
+    
+    bool beginDynamic()
+    {
+        GLenum usage = Usage::Stream == m_usage ? GL_STREAM_DRAW : GL_DYNAMIC_DRAW;
+        if (Usage::Stream == m_usage) {
+            if (takePendingVertices(&m_streamData))
+                m_streamDataIsDirty = true;
+            if (m_streamDataIsDirty) {
+                if (0 != m_vertexBufferId)
+                    m_bufferIndex = (m_bufferIndex + 1) % m_bufferCount;
+                uploadVertices(m_bufferIndex, m_streamData);
+                m_streamDataIsDirty = false;
+            }
+        } else {
+            // Ranges queued after update() patch its vertices, earlier ones were dropped by update() itself
+            std::vector<uint8_t> data;
+            if (takePendingVertices(&data)) {
+                for (const auto &range: m_dirtyRanges) {
+                    if (range.offset + range.data.size() <= data.size())
+                        std::copy(range.data.begin(), range.data.end(), data.begin() + range.offset);
+                }
+                m_dirtyRanges.clear();
+                uploadVertices(0, data);
+            }
+            if (!m_dirtyRanges.empty() && 0 != m_vertexBufferIds[0]) {
+                glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferIds[0]);
+                for (const auto &range: m_dirtyRanges)
+                    glBufferSubData(GL_ARRAY_BUFFER, range.offset, range.data.size(), range.data.data());
+            }
+            m_dirtyRanges.clear();
+        }
+        m_vertexBufferId = m_vertexBufferIds[m_bufferIndex];
+        if (0 == m_vertexBufferId)
+            return false;
+        uploadIndices(usage);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferId);
+        if (0 != m_indexBufferId)
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBufferId);
+        return true;
+    }
 };
 
 }
@@ -24,6 +24,8 @@
 #define HU_GLES_VERTEX_BUFFER_UTILS_H_
 
 #include <set>
+#include <cstring>
+#include <unordered_map>
 #include <hu/gles/vertex_buffer.h>
 #include <hu/base/vector3.h>
 
@@ -33,47 +35,59 @@ namespace Hu
 class VertexBufferUtils
 {
 public:
+    // Each triangle corner becomes a position and normal pair, equal pairs are stored once and referenced by index. 
+    // Normals come from triangleVertexNormals (three per triangle) when given, otherwise the face normal is used. 
+    // The colour is left out, the engine feeds the constant white to the shader
     static void loadTrangulatedMesh(VertexBuffer &vertexBuffer, 
         const std::vector<Vector3> &vertices,
         const std::vector<std::vector<size_t>> &triangles,
-        uint32_t drawHint)
+        uint32_t drawHint,
+        const std::vector<Vector3> *triangleVertexNormals=nullptr)
     {
         auto vertexBufferVertices = std::make_unique<std::vector<GLfloat>>();
-        size_t numbersPerVertex = 9;
-        vertexBufferVertices->resize(triangles.size() * 3 * numbersPerVertex);
-        for (size_t i = 0, targetIndex = 0; i < triangles.size(); ++i) {
-            const auto &triangle = triangles[i];
-            Vector3 triangleNormal = Vector3::normal(vertices[triangle[0]], vertices[triangle[1]], vertices[triangle[2]]);
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)vertices[triangle[0]].x();
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)vertices[triangle[0]].y();
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)vertices[triangle[0]].z();
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)triangleNormal.x();
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)triangleNormal.y();
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)triangleNormal.z();
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)1.0;
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)1.0;
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)1.0;
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)vertices[triangle[1]].x();
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)vertices[triangle[1]].y();
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)vertices[triangle[1]].z();
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)triangleNormal.x();
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)triangleNormal.y();
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)triangleNormal.z();
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)1.0;
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)1.0;
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)1.0;
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)vertices[triangle[2]].x();
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)vertices[triangle[2]].y();
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)vertices[triangle[2]].z();
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)triangleNormal.x();
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)triangleNormal.y();
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)triangleNormal.z();
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)1.0;
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)1.0;
-            vertexBufferVertices->at(targetIndex++) = (GLfloat)1.0;
-        }
+        auto vertexBufferIndices = std::make_unique<std::vector<GLuint>>();
+        indexTrangulatedMesh(vertices, triangles, triangleVertexNormals, vertexBufferVertices.get(), vertexBufferIndices.get());
+        size_t numbersPerVertex = 6;
         size_t vertexCount = vertexBufferVertices->size() / numbersPerVertex;
-        vertexBuffer.update(std::move(vertexBufferVertices), numbersPerVertex, vertexCount, drawHint);
+        vertexBuffer.update(std::move(vertexBufferVertices), numbersPerVertex, vertexCount, drawHint, std::move(vertexBufferIndices));
+    }
+    
+    // Same as above, packed into a compact format such as Int16 positions with Int2101010 normals (12 bytes per vertex)
+    static void loadTrangulatedMesh(VertexBuffer &vertexBuffer, 
+        const std::vector<Vector3> &vertices,
+        const std::vector<std::vector<size_t>> &triangles,
+        uint32_t drawHint,
+        const VertexLayout::Format &format,
+        const std::vector<Vector3> *triangleVertexNormals=nullptr)
+    {
+        std::vector<GLfloat> indexedVertices;
+        auto vertexBufferIndices = std::make_unique<std::vector<GLuint>>();
+        indexTrangulatedMesh(vertices, triangles, triangleVertexNormals, &indexedVertices, vertexBufferIndices.get());
+        size_t vertexCount = indexedVertices.size() / 6;
+        VertexLayout layout(format);
+        if (layout.hasPositionMatrix()) {
+            Vector3 lower, upper;
+            for (size_t i = 0; i < vertexCount; ++i) {
+                Vector3 position(indexedVertices[i * 6], indexedVertices[i * 6 + 1], indexedVertices[i * 6 + 2]);
+                if (0 == i) {
+                    lower = upper = position;
+                    continue;
+                }
+                for (size_t axis = 0; axis < 3; ++axis) {
+                    lower[axis] = std::min(lower[axis], position[axis]);
+                    upper[axis] = std::max(upper[axis], position[axis]);
+                }
+            }
+            Vector3 halfSize = (upper - lower) * 0.5;
+            layout.setPositionBounds((lower + upper) * 0.5, std::max(halfSize.x(), std::max(halfSize.y(), halfSize.z())));
+        }
+        auto vertexData = std::make_unique<std::vector<uint8_t>>(vertexCount * layout.stride());
+        for (size_t i = 0; i < vertexCount; ++i) {
+            const GLfloat *vertex = indexedVertices.data() + i * 6;
+            layout.packVertex(vertexData->data() + i * layout.stride(), 
+                Vector3(vertex[0], vertex[1], vertex[2]), Vector3(vertex[3], vertex[4], vertex[5]));
+        }
+        vertexBuffer.update(std::move(vertexData), layout, vertexCount, drawHint, std::move(vertexBufferIndices));
     }
     
     static void loadMeshBorders(VertexBuffer &vertexBuffer, 
@@ -118,6 +132,63 @@ public:
         size_t vertexCount = vertexBufferVertices->size() / numbersPerVertex;
         vertexBuffer.update(std::move(vertexBufferVertices), numbersPerVertex, vertexCount, drawHint);
     }
+    
+private:
+    static void indexTrangulatedMesh(const std::vector<Vector3> &vertices,
+        const std::vector<std::vector<size_t>> &triangles,
+        const std::vector<Vector3> *triangleVertexNormals,
+        std::vector<GLfloat> *indexedVertices,
+        std::vector<GLuint> *indices)
+    {
+        size_t numbersPerVertex = 6;
+        indexedVertices->reserve(vertices.size() * numbersPerVertex);
+        indices->reserve(triangles.size() * 3);
+        std::unordered_map<IndexedVertex, GLuint, IndexedVertexHash> indexMap;
+        indexMap.reserve(vertices.size() * 2);
+        for (size_t i = 0; i < triangles.size(); ++i) {
+            const auto &triangle = triangles[i];
+            Vector3 triangleNormal;
+            if (nullptr == triangleVertexNormals)
+                triangleNormal = Vector3::normal(vertices[triangle[0]], vertices[triangle[1]], vertices[triangle[2]]);
+            for (size_t j = 0; j < 3; ++j) {
+                const auto &normal = nullptr == triangleVertexNormals ? triangleNormal : (*triangleVertexNormals)[i * 3 + j];
+                IndexedVertex indexedVertex = {triangle[j], {(GLfloat)normal.x(), (GLfloat)normal.y(), (GLfloat)normal.z()}};
+                auto insertResult = indexMap.insert({indexedVertex, (GLuint)(indexedVertices->size() / numbersPerVertex)});
+                if (insertResult.second) {
+                    const auto &position = vertices[triangle[j]];
+                    indexedVertices->push_back((GLfloat)position.x());
+                    indexedVertices->push_back((GLfloat)position.y());
+                    indexedVertices->push_back((GLfloat)position.z());
+                    indexedVertices->insert(indexedVertices->end(), indexedVertex.normal, indexedVertex.normal + 3);
+                }
+                indices->push_back(insertResult.first->second);
+            }
+        }
+    }
+    
+    struct IndexedVertex
+    {
+        size_t vertexIndex;
+        GLfloat normal[3];
+        
+        bool operator==(const IndexedVertex &other) const
+        {
+            return vertexIndex == other.vertexIndex && 0 == memcmp(normal, other.normal, sizeof(normal));
+        }
+    };
+    
+    struct IndexedVertexHash
+    {
+        size_t operator()(const IndexedVertex &indexedVertex) const
+        {
+            uint32_t bits[3];
+            memcpy(bits, indexedVertex.normal, sizeof(bits));
+            uint64_t hash = indexedVertex.vertexIndex * 0x9e3779b97f4a7c15ull;
+            for (size_t i = 0; i < 3; ++i)
+                hash = (hash ^ bits[i]) * 0x100000001b3ull;
+            return (size_t)(hash ^ (hash >> 32));
+        }
+    };
 };
     
 };
@@ -0,0 +1,242 @@
+/*
+ *  Copyright (c) 2022 Jeremy HU <jeremy-at-dust3d dot org>. All rights reserved. 
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#ifndef HU_GLES_VERTEX_LAYOUT_H_
+#define HU_GLES_VERTEX_LAYOUT_H_
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <GLES2/gl2.h>
+#include <hu/base/color.h>
+#include <hu/base/matrix4x4.h>
+#include <hu/base/vector3.h>
+
+#ifndef GL_INT_2_10_10_10_REV
+#define GL_INT_2_10_10_10_REV 0x8D9F
+#endif
+
+namespace Hu
+{
+
+// Describes how the attributes of one vertex are laid out in a vertex buffer
+class VertexLayout
+{
+public:
+    enum class PositionFormat
+    {
+        Float,
+        Int16
+    };
+    
+    enum class NormalFormat
+    {
+        None,
+        Float,
+        Int2101010
+    };
+    
+    enum class ColorFormat
+    {
+        None,
+        Float,
+        Rgba8
+    };
+    
+    struct Format
+    {
+        PositionFormat position = PositionFormat::Float;
+        NormalFormat normal = NormalFormat::Float;
+        ColorFormat color = ColorFormat::None;
+    };
+    
+    struct Attribute
+    {
+        GLuint location;
+        GLint size;
+        GLenum type;
+        GLboolean normalized;
+        size_t offset;
+    };
+    
+    VertexLayout() = default;
+    
+    // Position at location 0, normal at 1 and color at 2, matching the model shaders
+    VertexLayout(const Format &format)
+    {
+        if (PositionFormat::Int16 == format.position)
+            addAttribute(0, 3, GL_SHORT, GL_TRUE, sizeof(int16_t) * 4);
+        else
+            addAttribute(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 3);
+        if (NormalFormat::Int2101010 == format.normal)
+            addAttribute(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(uint32_t));
+        else if (NormalFormat::Float == format.normal)
+            addAttribute(1, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 3);
+        if (ColorFormat::Rgba8 == format.color)
+            addAttribute(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(uint8_t) * 4);
+        else if (ColorFormat::Float == format.color)
+            addAttribute(2, 4, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 4);
+        m_format = format;
+    }
+    
+    void addAttribute(GLuint location, GLint size, GLenum type, GLboolean normalized, size_t byteSize)
+    {
+        m_attributes.push_back({location, size, type, normalized, m_stride});
+        m_stride += byteSize;
+    }
+    
+    // For vertices carrying numbers no attribute reads
+    void setStride(size_t stride)
+    {
+        m_stride = stride;
+    }
+    
+    const std::vector<Attribute> &attributes() const
+    {
+        return m_attributes;
+    }
+    
+    bool isEmpty() const
+    {
+        return m_attributes.empty();
+    }
+    
+    bool hasAttribute(GLuint location) const
+    {
+        for (const auto &it: m_attributes) {
+            if (it.location == location)
+                return true;
+        }
+        return false;
+    }
+    
+    size_t stride() const
+    {
+        return m_stride;
+    }
+    
+    // Equal for layouts with the same attributes and stride, used to sort draws sharing attribute setup together
+    uint64_t key() const
+    {
+        uint64_t hash = 0xcbf29ce484222325ull ^ m_stride;
+        for (const auto &it: m_attributes) {
+            for (uint64_t value: {(uint64_t)it.location, (uint64_t)it.size, (uint64_t)it.type, (uint64_t)it.normalized, (uint64_t)it.offset})
+                hash = (hash ^ value) * 0x100000001b3ull;
+        }
+        return hash;
+    }
+    
+    const Format &format() const
+    {
+        return m_format;
+    }
+    
+    // Int16 positions are stored relative to the bounding box center, divided by its largest half extent. 
+    // The scale is uniform so the decode matrix can be folded into the model matrix without skewing normals
+    void setPositionBounds(const Vector3 &center, double halfExtent)
+    {
+        m_positionCenter = center;
+        m_positionHalfExtent = halfExtent;
+    }
+    
+    bool hasPositionMatrix() const
+    {
+        return PositionFormat::Int16 == m_format.position;
+    }
+    
+    Matrix4x4 positionMatrix() const
+    {
+        Matrix4x4 matrix;
+        matrix.translate(m_positionCenter);
+        matrix.scale(Vector3(m_positionHalfExtent, m_positionHalfExtent, m_positionHalfExtent));
+        return matrix;
+    }
+    
+    // Writes one vertex at target, which must have stride() bytes
+    void packVertex(uint8_t *target, const Vector3 &position, const Vector3 &normal, const Color &color=Color(1.0, 1.0, 1.0)) const
+    {
+        for (const auto &attribute: m_attributes) {
+            uint8_t *data = target + attribute.offset;
+            switch (attribute.location) {
+            case 0:
+                if (GL_SHORT == attribute.type) {
+                    double scale = Math::isZero(m_positionHalfExtent) ? 0.0 : 1.0 / m_positionHalfExtent;
+                    int16_t values[4] = {packInt16((position.x() - m_positionCenter.x()) * scale),
+                        packInt16((position.y() - m_positionCenter.y()) * scale),
+                        packInt16((position.z() - m_positionCenter.z()) * scale),
+                        0};
+                    memcpy(data, values, sizeof(values));
+                } else {
+                    GLfloat values[3] = {(GLfloat)position.x(), (GLfloat)position.y(), (GLfloat)position.z()};
+                    memcpy(data, values, sizeof(values));
+                }
+                break;
+            case 1:
+                if (GL_INT_2_10_10_10_REV == attribute.type) {
+                    uint32_t value = packInt10(normal.x()) | (packInt10(normal.y()) << 10) | (packInt10(normal.z()) << 20);
+                    memcpy(data, &value, sizeof(value));
+                } else {
+                    GLfloat values[3] = {(GLfloat)normal.x(), (GLfloat)normal.y(), (GLfloat)normal.z()};
+                    memcpy(data, values, sizeof(values));
+                }
+                break;
+            case 2:
+                if (GL_UNSIGNED_BYTE == attribute.type) {
+                    uint8_t values[4] = {packUint8(color.red()), packUint8(color.green()), packUint8(color.blue()), packUint8(color.alpha())};
+                    memcpy(data, values, sizeof(values));
+                } else {
+                    GLfloat values[4] = {(GLfloat)color.red(), (GLfloat)color.green(), (GLfloat)color.blue(), (GLfloat)color.alpha()};
+                    memcpy(data, values, sizeof(values));
+                }
+                break;
+            }
+        }
+    }
+    
+private:
+    std::vector<Attribute> m_attributes;
+    size_t m_stride = 0;
+    Format m_format;
+    Vector3 m_positionCenter;
+    double m_positionHalfExtent = 1.0;
+    
+    static int16_t packInt16(double value)
+    {
+        return (int16_t)std::lround(std::clamp(value, -1.0, 1.0) * 32767.0);
+    }
+    
+    static uint32_t packInt10(double value)
+    {
+        return (uint32_t)std::lround(std::clamp(value, -1.0, 1.0) * 511.0) & 0x3ff;
+    }
+    
+    static uint8_t packUint8(double value)
+    {
+        return (uint8_t)std::lround(std::clamp(value, 0.0, 1.0) * 255.0);
+    }
+};
+
+}
+
+#endif